@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "AstarGraph.hpp"
+#include "Quadtree.hpp"
+
+/**
+ * Arc flags for the leaf graph of a static map.
+ *
+ * Valid leafs are split into up to 64 regions of equal size along their
+ * Morton order. Every edge keeps a bitmask of the regions it starts a
+ * shortest path towards, so a search can skip edges that lead away from
+ * the goal region. Costs 8 bytes per edge.
+ */
+class ArcFlags {
+public:
+    static constexpr int MAX_REGIONS = 64;
+
+    void Build(const Quadtree& quadtree, const AstarGraph& graph, int numRegions);
+
+    int GetNumRegions() const {
+        return numRegions;
+    }
+
+    int GetRegion(int node) const {
+        return regions[node];
+    }
+
+    uint64_t GetRegionMask(int node) const {
+        return (uint64_t)1 << regions[node];
+    }
+
+    uint64_t GetFlags(int edge) const {
+        return flags[edge];
+    }
+
+    size_t GetMemoryUsage() const {
+        return flags.size() * sizeof(uint64_t) + regions.size() * sizeof(uint8_t);
+    }
+
+    void Clear();
+
+private:
+    int numRegions = 0;
+
+    std::vector<uint8_t> regions;
+    std::vector<uint64_t> flags;
+};
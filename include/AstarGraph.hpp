@@ -65,6 +65,11 @@ public:
 
     void Build(const Quadtree &quadtree);
 
+    // Cost per unit length in each terrain class, used by the next Build.
+    // Costs below 1 are raised to 1 so Euclidean distance stays a lower
+    // bound, classes past the end cost 1.
+    void SetTerrainCosts(const std::vector<float>& terrainCosts);
+
     const std::vector<AstarNode>& GetNodes() const {
         return nodes;
     }
@@ -79,8 +84,9 @@ public:
 private:
     std::vector<AstarNode> nodes;
     std::vector<AstarEdge> edges;
+    std::vector<float> terrainCosts;
 
     void AddNode(int x, int y,int edgeIndex);
-    void AddEdge(int nodeIdA, int nodeIdB);
+    void AddEdge(const Quadtree &quadtree, int nodeIdA, int nodeIdB);
 
 };
\ No newline at end of file
@@ -1,12 +1,155 @@
 #pragma once
 
+#include <cstdint>
+#include <vector>
+
+#include "ArcFlags.hpp"
 #include "AstarGraph.hpp"
+#include "ClearanceMap.hpp"
+#include "Heap.hpp"
+#include "LandmarkHeuristic.hpp"
+#include "ObstacleOverlay.hpp"
+#include "PathCache.hpp"
+#include "RadixHeap.hpp"
+
+enum SearchMode {
+    SEARCH_OPTIMAL,
+    SEARCH_WEIGHTED, // gScore + weight * hScore
+    SEARCH_FOCAL     // weighted among fScores within weight of the smallest
+};
+
+enum OpenList {
+    OPEN_LIST_BINARY_HEAP,
+    OPEN_LIST_RADIX_HEAP // fixed point fScores, optimal mode only since weighted keys are not monotone
+};
+
+enum PathStatus {
+    PATH_FOUND,
+    PATH_NOT_FOUND,
+    PATH_TRUNCATED // the buffer holds the first waypoints of a longer path
+};
+
+struct SearchOptions {
+    SearchMode mode = SEARCH_OPTIMAL;
+    OpenList openList = OPEN_LIST_BINARY_HEAP;
+
+    // Allowed ratio between the path cost and the optimum, at least 1
+    float weight = 1.0f;
+
+    // Radius of the agent in cells, only used while a clearance map is set
+    float agentRadius = 0.0f;
+};
 
 class AstarSearch {
 public:
+    AstarSearch();
+
     std::vector<int> GetPath(
       const Quadtree& quadtree, const AstarGraph& graph,
       int fromX, int fromY, int toX, int toY);
 
+    // Trades path cost for fewer expansions, paths found this way are
+    // not stored in the path cache
+    std::vector<int> GetPath(
+      const Quadtree& quadtree, const AstarGraph& graph,
+      int fromX, int fromY, int toX, int toY, const SearchOptions& options);
+
+    // Writes the path as x y coords into coords in forward order, numCoords
+    // receives how many were written. Does not allocate once the workspace
+    // has grown to the graph.
+    PathStatus GetPath(
+      const Quadtree& quadtree, const AstarGraph& graph,
+      int fromX, int fromY, int toX, int toY,
+      int* coords, int capacity, int& numCoords,
+      const SearchOptions& options = SearchOptions());
+
+    // Searches from both ends with the average of the forward and backward
+    // heuristics, stops once the two frontier keys cover the best meeting.
+    // With isThreaded each direction runs on its own thread. The overlay
+    // and the clearance map apply as in the other searches.
+    std::vector<int> GetPathBidirectional(
+      const Quadtree& quadtree, const AstarGraph& graph,
+      int fromX, int fromY, int toX, int toY, bool isThreaded = false,
+      float agentRadius = 0.0f);
+
+    // Tightens the Euclidean heuristic with ALT bounds built on the same graph,
+    // nullptr for Euclidean only
+    void SetLandmarks(const LandmarkHeuristic* landmarks) {
+        this->landmarks = landmarks;
+    }
+
+    // Skips edges whose flags exclude the goal region, nullptr to search every edge
+    void SetArcFlags(const ArcFlags* arcFlags) {
+        this->arcFlags = arcFlags;
+    }
+
+    // Answers from the cache when it can and stores every path found,
+    // nullptr to always search
+    void SetPathCache(PathCache* pathCache) {
+        this->pathCache = pathCache;
+    }
+
+    // Skips blocked leafs and adds the extra cost of entering a leaf, the
+    // start leaf is always left. Arc flags and the path cache are bypassed
+    // while set since they hold paths for the graph alone, nullptr for none.
+    // Searches on a tree the overlay was not reset for find no path.
+    void SetOverlay(const ObstacleOverlay* overlay) {
+        this->overlay = overlay;
+    }
+
+    // Skips edges too narrow for the agent radius of the search options.
+    // Arc flags and the path cache are bypassed for radii above 0 since
+    // they hold paths for a point agent, nullptr for none.
+    void SetClearance(const ClearanceMap* clearance) {
+        this->clearance = clearance;
+    }
+
+    // Nodes expanded by the last search
+    int GetNumExpanded() const {
+        return numExpanded;
+    }
+
+    // Ratio the last path may exceed the optimum by, the weight for
+    // weighted search and the cost over the final smallest fScore for focal
+    float GetBound() const {
+        return bound;
+    }
+
+private:
+    const LandmarkHeuristic* landmarks = nullptr;
+    const ArcFlags* arcFlags = nullptr;
+    PathCache* pathCache = nullptr;
+    const ObstacleOverlay* overlay = nullptr;
+    const ClearanceMap* clearance = nullptr;
+
+    int numExpanded = 0;
+    float bound = 1.0f;
+    float agentRadius = 0.0f;
+
+    // Search workspace, index 0 forward, index 1 backward. A label packs
+    // the stamp above the gScore bits so the other direction of a
+    // bidirectional search reads both in a single load.
+    std::vector<uint64_t> labels[2];
+    std::vector<int> parent[2];
+    std::vector<unsigned int> closed[2];
+    unsigned int stamp = 0;
+
+    // Kept between searches so their storage stays allocated
+    Heap<float> openSet;
+    RadixHeap radixHeap;
+    std::vector<int> leafPath;
+
+    // Invalidates the labels of the previous search
+    void PrepareWorkspace(int numNodes);
+
+    int FindLeafPath(
+      const Quadtree& quadtree, const AstarGraph& graph,
+      int fromX, int fromY, int toX, int toY, const SearchOptions& options);
+
+    bool SearchWeighted(const AstarGraph& graph, int fromRegionIndex, int toRegionIndex, int toX, int toY, float weight);
+    bool SearchRadix(const AstarGraph& graph, int fromRegionIndex, int toRegionIndex, int toX, int toY);
+    bool SearchFocal(const AstarGraph& graph, int fromRegionIndex, int toRegionIndex, float weight);
 
-};
\ No newline at end of file
+    // Lower bound on the graph distance between two nodes
+    float Estimate(const AstarGraph& graph, int node, int target) const;
+};
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "ArcFlags.hpp"
+#include "AstarGraph.hpp"
+#include "AstarSearch.hpp"
+#include "LandmarkHeuristic.hpp"
+#include "Quadtree.hpp"
+
+struct PathRequest {
+    int fromX, fromY;
+    int toX, toY;
+};
+
+
+// Where a path landed in the arena. Size 0 for no path, offset -1 when the arena was full.
+struct PathResult {
+    int offset;
+    int size;
+};
+
+
+/**
+ * Preallocated storage for the paths of a batch, filled concurrently by
+ * bumping an atomic cursor.
+ */
+class PathArena {
+public:
+    void Reserve(int capacity) {
+        coords.resize(capacity);
+        this->Reset();
+    }
+
+    void Reset() {
+        used = 0;
+    }
+
+    // Returns the offset of size free coords, or -1 when full. The cursor
+    // only moves when the path fits, so a path too large for the rest of
+    // the arena leaves room for smaller ones and the cursor cannot overflow.
+    int Allocate(int size) {
+        const int capacity = coords.size();
+        int offset = used.load(std::memory_order_relaxed);
+
+        do {
+            if (size > capacity - offset) {
+                return -1;
+            }
+        } while (!used.compare_exchange_weak(offset, offset + size, std::memory_order_relaxed));
+
+        return offset;
+    }
+
+    int* GetCoords(int offset) {
+        return &coords[offset];
+    }
+
+    const int* GetCoords(int offset) const {
+        return &coords[offset];
+    }
+
+    int GetCapacity() const {
+        return coords.size();
+    }
+
+private:
+    std::vector<int> coords;
+    std::atomic<int> used{0};
+};
+
+
+/**
+ * Runs many path queries against one immutable quadtree and graph.
+ *
+ * Requests are resolved to leafs, sorted by the Morton code of their
+ * source leaf and deduplicated per leaf pair, then searched on a work
+ * stealing pool with one AstarSearch workspace per thread.
+ */
+class BatchSearch {
+public:
+    BatchSearch();
+
+    void SetNumThreads(int numThreads);
+
+    // Passed on to every worker search
+    void SetLandmarks(const LandmarkHeuristic* landmarks) {
+        this->landmarks = landmarks;
+    }
+
+    void SetArcFlags(const ArcFlags* arcFlags) {
+        this->arcFlags = arcFlags;
+    }
+
+    // results[i] receives the path of requests[i] as x y coords in the arena
+    void Run(
+        const Quadtree& quadtree, const AstarGraph& graph,
+        const PathRequest* requests, int numRequests,
+        PathArena& arena, PathResult* results);
+
+    // Distinct leaf pairs searched by the last run
+    int GetNumSearches() const {
+        return numSearches;
+    }
+
+private:
+    int numThreads;
+    int numSearches = 0;
+
+    const LandmarkHeuristic* landmarks = nullptr;
+    const ArcFlags* arcFlags = nullptr;
+
+    std::vector<AstarSearch> searches;
+
+    // One path buffer per worker, grown as needed and reused across runs
+    std::vector<std::vector<int>> buffers;
+
+    // Request indices grouped by leaf pair
+    std::vector<uint64_t> pairs;
+    std::vector<int> order;
+    std::vector<int> groupBegin;
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "AstarGraph.hpp"
+#include "GridEnvironment.hpp"
+#include "Quadtree.hpp"
+
+/**
+ * Clearance of the leaf graph for agents of any radius.
+ *
+ * An exact Euclidean distance transform of the grid gives every valid
+ * cell its distance to the nearest blocked cell, the area outside the
+ * grid counting as blocked. A leaf keeps the largest distance of its
+ * cells and an edge the largest distance at which a disc can cross the
+ * side its two leafs share. Costs 4 bytes per edge and per leaf.
+ */
+class ClearanceMap {
+public:
+    void Build(const GridEnvironment& grid, const Quadtree& quadtree, const AstarGraph& graph);
+
+    float GetLeafClearance(int node) const {
+        return leafClearances[node];
+    }
+
+    float GetEdgeClearance(int edge) const {
+        return edgeClearances[edge];
+    }
+
+    size_t GetMemoryUsage() const {
+        return (leafClearances.size() + edgeClearances.size()) * sizeof(float);
+    }
+
+    void Clear();
+
+private:
+    std::vector<float> leafClearances;
+    std::vector<float> edgeClearances;
+};
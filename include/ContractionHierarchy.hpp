@@ -0,0 +1,155 @@
+#pragma once
+
+#include <vector>
+
+#include "AstarGraph.hpp"
+#include "Quadtree.hpp"
+
+class ContractionEdge {
+public:
+    ContractionEdge(int target, float dist, int middle)
+    : target(target), dist(dist), middle(middle) {}
+
+    int GetTarget() const {
+        return target;
+    }
+
+    float GetDist() const {
+        return dist;
+    }
+
+    // Contracted node the shortcut bypasses, -1 for an edge of the leaf graph
+    int GetMiddle() const {
+        return middle;
+    }
+
+    void Improve(float dist, int middle) {
+        this->dist = dist;
+        this->middle = middle;
+    }
+
+private:
+    int target;
+    float dist;
+    int middle;
+};
+
+
+/**
+ * Contraction hierarchy over the leaf graph for static maps.
+ *
+ * Nodes are contracted in rounds of independent sets, lowest edge
+ * difference first, each round in parallel. The leaf graph is undirected,
+ * so a single upward graph serves both search directions.
+ */
+class ContractionHierarchy {
+public:
+    void Build(const AstarGraph& graph);
+
+    int GetRank(int node) const {
+        return rank[node];
+    }
+
+    int GetNumNodes() const {
+        return rank.size();
+    }
+
+    int GetEdgeIndex(int node) const {
+        return edgeIndex[node];
+    }
+
+    int GetNumEdges(int node) const {
+        return edgeIndex[node + 1] - edgeIndex[node];
+    }
+
+    // Edges to higher ranked nodes
+    const std::vector<ContractionEdge>& GetUpwardEdges() const {
+        return upwardEdges;
+    }
+
+    // Appends the leaf nodes after from up to and including to
+    void Unpack(int from, const ContractionEdge& edge, std::vector<int>& nodes) const;
+
+    void Clear();
+
+private:
+    std::vector<int> rank;
+    std::vector<int> edgeIndex;
+    std::vector<ContractionEdge> upwardEdges;
+
+    const ContractionEdge* FindUpwardEdge(int from, int to) const;
+};
+
+
+/**
+ * Bidirectional upward query on a contraction hierarchy.
+ * Holds the search workspace, use one per thread.
+ */
+class ContractionSearch {
+public:
+    // Returns a list of x y coords
+    std::vector<int> GetPath(
+      const Quadtree& quadtree, const AstarGraph& graph, const ContractionHierarchy& hierarchy,
+      int fromX, int fromY, int toX, int toY);
+
+    // Shortest distance between two leaf nodes, fills the leaf nodes of the path if given
+    float GetDistance(const ContractionHierarchy& hierarchy, int fromNode, int toNode, std::vector<int>* nodePath);
+
+    int GetNumSettled() const {
+        return numSettled;
+    }
+
+private:
+    int numSettled = 0;
+
+    // Index 0 forward, index 1 backward
+    std::vector<float> distances[2];
+    std::vector<int> parentEdge[2];
+    std::vector<int> parentNode[2];
+    std::vector<unsigned int> visited[2];
+    unsigned int stamp = 0;
+};
+
+
+/**
+ * Distance matrix between many sources and targets on a contraction
+ * hierarchy. Every target leaves its upward search space in buckets, then
+ * the upward search of each source scans the buckets it reaches, so the
+ * work is one search per source and per target instead of one per pair.
+ */
+class ManyToManySearch {
+public:
+    // Sources and targets are x y coords, the matrix is row major by source with
+    // -1 where there is no path. Entries match the length of ContractionSearch::GetPath.
+    std::vector<float> GetDistances(
+      const Quadtree& quadtree, const AstarGraph& graph, const ContractionHierarchy& hierarchy,
+      const std::vector<int>& sources, const std::vector<int>& targets);
+
+    // Leaf graph distances between nodes, same layout, -1 nodes give -1 rows and columns
+    std::vector<float> GetNodeDistances(
+      const ContractionHierarchy& hierarchy,
+      const std::vector<int>& sourceNodes, const std::vector<int>& targetNodes);
+
+private:
+    struct BucketEntry {
+        int target;
+        float dist;
+    };
+
+    // Upward search state of one thread
+    struct Workspace {
+        std::vector<float> distances;
+        std::vector<unsigned int> visited;
+        std::vector<int> settled;
+        unsigned int stamp = 0;
+    };
+
+    std::vector<Workspace> workspaces;
+
+    // Buckets of every node in CSR layout
+    std::vector<int> bucketIndex;
+    std::vector<BucketEntry> buckets;
+
+    // Settles the whole upward search space of root into workspace.settled
+    void SearchUpward(const ContractionHierarchy& hierarchy, Workspace& workspace, int root);
+};
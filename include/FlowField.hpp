@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "AstarGraph.hpp"
+#include "Quadtree.hpp"
+
+/**
+ * Distance to one goal and the next hop towards it for every leaf, from a
+ * single Dijkstra rooted at the goal. Units heading to the same goal read
+ * their direction from the field instead of searching one by one.
+ */
+class FlowField {
+public:
+    // Builds the field, false when the goal is not in a valid leaf
+    bool Build(const Quadtree& quadtree, const AstarGraph& graph, int goalX, int goalY);
+
+    // Rebuilds only if the quadtree was rebuilt or the goal moved
+    bool Update(const Quadtree& quadtree, const AstarGraph& graph, int goalX, int goalY);
+
+    // Unit direction to steer along from (x, y), false when the goal is unreachable
+    bool NextDirection(const Quadtree& quadtree, const AstarGraph& graph, int x, int y, float& dirX, float& dirY) const;
+
+    // Graph distance from the leaf centre to the goal leaf, -1 when unreachable
+    float GetDistance(int leaf) const {
+        return distances[leaf];
+    }
+
+    // Next leaf towards the goal, -1 for the goal leaf and unreachable leafs
+    int GetNextLeaf(int leaf) const {
+        return nextLeaf[leaf];
+    }
+
+    int GetGoalLeaf() const {
+        return goalLeaf;
+    }
+
+    void Clear();
+
+private:
+    uint64_t version = 0;
+
+    int goalX = 0;
+    int goalY = 0;
+    int goalLeaf = -1;
+
+    std::vector<float> distances;
+    std::vector<int> nextLeaf;
+};
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <vector>
+
+#include "QuadtreeForest.hpp"
+
+/**
+ * A* over a tiled world. Moves within a tile follow the tile graph,
+ * moves across a tile border follow overlapping border portals.
+ */
+class ForestSearch {
+public:
+    // Returns a list of x y world coords, empty if there is no path
+    std::vector<int> GetPath(TileProvider& tiles, int fromX, int fromY, int toX, int toY);
+
+    int GetNumExpanded() const {
+        return numExpanded;
+    }
+
+private:
+    int numExpanded = 0;
+};
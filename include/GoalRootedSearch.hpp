@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <vector>
+
+#include "AstarGraph.hpp"
+#include "Quadtree.hpp"
+
+/**
+ * Backward A* from the goal whose search tree is kept between queries.
+ *
+ * Closed leafs hold exact distances to the goal, so a start that lands in
+ * the closed set is answered by walking parents. Any other start resumes
+ * the previous search with the open list re-keyed for the new start,
+ * which is sound because the Euclidean heuristic is consistent. The tree
+ * is dropped when the goal leaf or the quadtree changes.
+ */
+class GoalRootedSearch {
+public:
+    // Returns a list of x y coords
+    std::vector<int> GetPath(
+      const Quadtree& quadtree, const AstarGraph& graph,
+      int fromX, int fromY, int toX, int toY);
+
+    // Nodes expanded by the last query, 0 when answered from the tree
+    int GetNumExpanded() const {
+        return numExpanded;
+    }
+
+    void Clear();
+
+private:
+    struct QueueEntry {
+        float key;
+        int node;
+
+        bool operator>(const QueueEntry& other) const {
+            return key > other.key;
+        }
+    };
+
+    uint64_t version = 0;
+    int goalNode = -1;
+
+    int numExpanded = 0;
+
+    // Stamped so a new goal does not clear them
+    std::vector<float> gScores;
+    std::vector<int> parents;
+    std::vector<unsigned int> visited;
+    std::vector<unsigned int> closed;
+    unsigned int stamp = 0;
+
+    // Labelled but not closed yet, may hold closed leftovers until the next re-key
+    std::vector<int> openNodes;
+
+    void Reset(const Quadtree& quadtree, const AstarGraph& graph, int goalNode);
+};
@@ -3,11 +3,29 @@
 #include <cstddef>
 #include <vector>
 
+// Terrain classes run from 0, blocked, up to MAX_TERRAIN
+constexpr int MAX_TERRAIN = 15;
+
 
 class GridEnvironment {
 public:
     virtual const bool IsValid(int i) const = 0;
 
+    // Coordinate lookup, override for worlds too large for a linear index
+    virtual const bool IsValidAt(size_t x, size_t y) const {
+        return IsValid(y * gridWidth + x);
+    }
+
+    // Terrain class of a cell, 0 is blocked. Cells only merge into one leaf
+    // when their classes match.
+    virtual const int GetTerrain(int i) const {
+        return IsValid(i) ? 1 : 0;
+    }
+
+    virtual const int GetTerrainAt(size_t x, size_t y) const {
+        return GetTerrain(y * gridWidth + x);
+    }
+
     const size_t GetWidth() const {
         return gridWidth;
     }
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "AstarGraph.hpp"
+#include "Quadtree.hpp"
+
+/**
+ * Hash distributed A* for a single long query.
+ *
+ * Every leaf is owned by one thread, picked by a hash of its index. A
+ * thread only expands and labels the leafs it owns, successors owned by
+ * another thread are sent to it through a lock free multi producer
+ * inbox. Expansion order is no longer global, so leafs may be reopened,
+ * and the search runs until every thread is out of work below the best
+ * goal cost and no message is in flight. The cost matches a serial
+ * search on the same graph.
+ */
+class HashDistributedSearch {
+public:
+    HashDistributedSearch();
+
+    void SetNumThreads(int numThreads);
+
+    // Returns a list of x y coords
+    std::vector<int> GetPath(
+      const Quadtree& quadtree, const AstarGraph& graph,
+      int fromX, int fromY, int toX, int toY);
+
+    // Expansions summed over every thread in the last search
+    int GetNumExpanded() const {
+        return numExpanded;
+    }
+
+private:
+    struct Message {
+        int node;
+        int parent;
+        float gScore;
+        Message* next;
+    };
+
+    struct alignas(64) Worker {
+        std::atomic<Message*> inbox;
+        std::atomic<bool> isIdle;
+
+        // Messages this worker sent, kept until the search ends since
+        // the receiver reads them in place
+        std::deque<Message> sent;
+
+        int numExpanded;
+    };
+
+    int numThreads;
+    int numExpanded = 0;
+
+    std::unique_ptr<Worker[]> workers;
+
+    // Each entry is only touched by the thread owning that leaf
+    std::vector<float> gScores;
+    std::vector<int> parents;
+    std::vector<unsigned int> visited;
+    unsigned int stamp = 0;
+
+    int GetOwner(int node) const {
+        return (((uint32_t)node * 2654435761u) >> 16) % numThreads;
+    }
+};
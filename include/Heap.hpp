@@ -24,6 +24,9 @@ public:
         return size;
     }
 
+    // Empties the heap but keeps its storage
+    void Clear();
+
     ~Heap();
 
 private:
@@ -155,6 +158,12 @@ void Heap<T>::Swap(unsigned int hida, unsigned int hidb) {
     this->id2hid.insert_or_assign(this->hid2id[hida], hida);
 }
 
+template<typename T>
+void Heap<T>::Clear() {
+    this->id2hid.clear();
+    this->size = 0;
+}
+
 template<typename T>
 Heap<T>::~Heap() {
     this->heap.clear();
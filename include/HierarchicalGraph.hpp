@@ -0,0 +1,97 @@
+#pragma once
+
+#include <vector>
+
+#include "AstarGraph.hpp"
+#include "Quadtree.hpp"
+
+/**
+ * HPA* style abstraction of the leaf graph.
+ *
+ * Leafs are grouped into clusters by the quadtree block at clusterLevel
+ * that holds their corner, only blocks holding a leaf are numbered as
+ * clusters. Every entrance (run of leaf edges between two
+ * clusters) contributes one pair of abstract nodes, and the distances
+ * between the abstract nodes of a cluster are cached as intra edges.
+ */
+class HierarchicalGraph {
+public:
+    void Build(const Quadtree& quadtree, const AstarGraph& graph, int clusterLevel);
+
+    int GetCluster(int node) const {
+        return clusterOf[node];
+    }
+
+    int GetNumClusters() const {
+        return clusterEntrances.size();
+    }
+
+    // Leaf node of an abstract node
+    int GetLeafNode(int abstractNode) const {
+        return abstractNodes[abstractNode];
+    }
+
+    int GetNumAbstractNodes() const {
+        return abstractNodes.size();
+    }
+
+    // Abstract nodes inside a cluster
+    const std::vector<int>& GetEntrances(int cluster) const {
+        return clusterEntrances[cluster];
+    }
+
+    int GetEdgeIndex(int abstractNode) const {
+        return edgeIndex[abstractNode];
+    }
+
+    int GetNumEdges(int abstractNode) const {
+        return edgeIndex[abstractNode + 1] - edgeIndex[abstractNode];
+    }
+
+    const std::vector<AstarEdge>& GetEdges() const {
+        return edges;
+    }
+
+    void Clear();
+
+private:
+    std::vector<int> clusterOf;
+    std::vector<int> abstractOf;
+    std::vector<int> abstractNodes;
+    std::vector<std::vector<int>> clusterEntrances;
+
+    std::vector<int> edgeIndex;
+    std::vector<AstarEdge> edges;
+};
+
+
+/**
+ * Searches the abstract graph first, then refines with a leaf search
+ * restricted to the clusters the abstract path went through.
+ */
+class HierarchicalSearch {
+public:
+    // Returns a list of x y coords
+    std::vector<int> GetPath(
+      const Quadtree& quadtree, const AstarGraph& graph, const HierarchicalGraph& hierarchy,
+      int fromX, int fromY, int toX, int toY);
+
+    int GetNumExpanded() const {
+        return numExpanded;
+    }
+
+private:
+    int numExpanded = 0;
+
+    // Leaf search workspace, stamped so it is not reset between queries
+    std::vector<float> gScores;
+    std::vector<int> parent;
+    std::vector<unsigned int> visited;
+    unsigned int stamp = 0;
+
+    std::vector<char> allowedClusters;
+
+    bool RefinePath(
+      const AstarGraph& graph, const HierarchicalGraph& hierarchy,
+      int fromNode, int toNode, int toX, int toY);
+};
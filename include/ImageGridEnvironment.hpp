@@ -14,7 +14,16 @@ public:
         
     const bool IsValid(int i) const;
 
+    // Splits the gray levels of valid pixels evenly into classes 1 to numTerrains
+    const int GetTerrain(int i) const;
+
+    // 1 keeps the map binary
+    void SetNumTerrains(int numTerrains) {
+        this->numTerrains = numTerrains < 1 ? 1 : (numTerrains > MAX_TERRAIN ? MAX_TERRAIN : numTerrains);
+    }
+
 private:
     const Color *pixels;
+    int numTerrains = 1;
 
 };
\ No newline at end of file
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <vector>
+
+#include "AstarGraph.hpp"
+#include "Quadtree.hpp"
+
+/**
+ * Lifelong Planning A* between a fixed start and goal.
+ *
+ * The g and rhs values survive a rebuild of the quadtree. Only the vertices
+ * the search has touched hold finite values, so only those are carried over
+ * by leaf code, level and terrain class, and only they and their new neighbours are
+ * re-evaluated. A small edit far from the path settles almost nothing.
+ */
+class IncrementalSearch {
+public:
+    // Plans on the first call and after the start or goal leaf changes,
+    // repairs the previous plan after the quadtree was rebuilt.
+    // Returns a list of x y coords.
+    std::vector<int> GetPath(
+      const Quadtree& quadtree, const AstarGraph& graph,
+      int fromX, int fromY, int toX, int toY);
+
+    // Vertices made consistent by the last call
+    int GetNumExpanded() const {
+        return numExpanded;
+    }
+
+    void Clear();
+
+private:
+    struct QueueEntry {
+        float key1;
+        float key2;
+        int node;
+
+        bool operator>(const QueueEntry& other) const {
+            return key1 > other.key1 || (key1 == other.key1 && key2 > other.key2);
+        }
+    };
+
+    const Quadtree* quadtree = nullptr;
+    const AstarGraph* graph = nullptr;
+
+    uint64_t version = 0;
+    int fromNode = -1;
+    int toNode = -1;
+    LeafKey fromKey;
+    LeafKey toKey;
+
+    int numExpanded = 0;
+
+    std::vector<float> g;
+    std::vector<float> rhs;
+
+    // Vertices with an evaluated rhs and their leaf keys, every other
+    // vertex has infinite g and rhs
+    std::vector<int> touched;
+    std::vector<LeafKey> touchedKeys;
+    std::vector<char> isTouched;
+
+    std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>> openSet;
+
+    void Reset(const Quadtree& quadtree, const AstarGraph& graph, int fromNode, int toNode);
+    void Remap(const Quadtree& quadtree, const AstarGraph& graph);
+    void Touch(int node);
+
+    QueueEntry CalculateKey(int node) const;
+    void UpdateVertex(int node);
+    void ComputeShortestPath();
+};
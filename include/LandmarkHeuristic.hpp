@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstring>
+#include <vector>
+
+#include "AstarGraph.hpp"
+
+enum LandmarkStrategy {
+    FARTHEST,
+    AVOID
+};
+
+
+/**
+ * ALT (A*, landmarks, triangle inequality) lower bounds on the leaf graph.
+ *
+ * Distances to every landmark are stored per node, padded to a multiple of
+ * four so the bound is taken four landmarks at a time.
+ */
+class LandmarkHeuristic {
+public:
+    void Build(const AstarGraph& graph, int numLandmarks, LandmarkStrategy strategy);
+
+    // Lower bound on the graph distance between two nodes
+    float Estimate(int node, int target) const {
+        typedef float Lanes __attribute__((vector_size(16)));
+
+        const float* a = &distances[(size_t)node * stride];
+        const float* b = &distances[(size_t)target * stride];
+
+        Lanes best = {0, 0, 0, 0};
+
+        for (int i = 0; i < stride; i += 4) {
+            Lanes distanceA, distanceB;
+            std::memcpy(&distanceA, a + i, sizeof(Lanes));
+            std::memcpy(&distanceB, b + i, sizeof(Lanes));
+
+            Lanes bound = distanceA - distanceB;
+            bound = bound < 0 ? -bound : bound;
+            best = bound > best ? bound : best;
+        }
+
+        const float low = best[0] > best[1] ? best[0] : best[1];
+        const float high = best[2] > best[3] ? best[2] : best[3];
+        return low > high ? low : high;
+    }
+
+    const std::vector<int>& GetLandmarks() const {
+        return landmarks;
+    }
+
+    void Clear();
+
+private:
+    std::vector<int> landmarks;
+
+    // Unreachable nodes store 0, which keeps every bound admissible
+    std::vector<float> distances;
+    int stride = 0;
+
+    void SelectFarthest(const AstarGraph& graph, int numLandmarks);
+    void SelectAvoid(const AstarGraph& graph, int numLandmarks);
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <ankerl/unordered_dense.h>
+
+#include "GridEnvironment.hpp"
+#include "Quadtree.hpp"
+
+/**
+ * Quadtree whose blocks are only classified when a search reaches them.
+ *
+ * A block is scanned in Morton order until its first cell of another
+ * terrain class, so a mixed block costs the uniform prefix before that
+ * cell and the prefix is kept as uniform blocks. Results are cached per
+ * block and the blocks least recently used by a search are evicted down
+ * to the memory budget once a search ends. Leafs match those of
+ * Quadtree::Build on the same grid.
+ */
+class LazyQuadtree {
+public:
+    void Init(const GridEnvironment& grid, int maxLevel, size_t memoryBudget);
+
+    // Finds the leaf containing the point, false if it is blocked or off the grid
+    bool FindLeaf(int x, int y, Quadrant& leaf);
+
+    // Appends the valid leafs sharing a side with the leaf
+    void FindNeighbors(const Quadrant& leaf, std::vector<Quadrant>& neighbors);
+
+    // Ends a search, blocks it used are kept over older ones
+    void Trim();
+
+    // Drops every block, call after the grid changed
+    void Clear();
+
+    int GetResolution() const {
+        return resolution;
+    }
+
+    size_t GetMemoryUsage() const {
+        return blocks.size() * BLOCK_MEMORY;
+    }
+
+    int GetNumBlocks() const {
+        return blocks.size();
+    }
+
+    // Grid cells read since Init
+    long GetNumCellReads() const {
+        return numCellReads;
+    }
+
+private:
+    struct Block {
+        uint8_t terrain;
+        uint32_t lastUse;
+    };
+
+    // Key, value and the index entry of the map
+    static constexpr size_t BLOCK_MEMORY = sizeof(uint64_t) + sizeof(Block) + sizeof(uint32_t) * 2;
+    static constexpr uint8_t MIXED = 0xFF;
+
+    const GridEnvironment* grid;
+
+    int resolution;
+    int maxLevel;
+
+    size_t memoryBudget;
+    uint32_t clock;
+    long numCellReads;
+
+    // Location code shifted up by 5 bits with the level below it
+    ankerl::unordered_dense::map<uint64_t, Block> blocks;
+
+    // Terrain class of the block or MIXED
+    int Classify(uint64_t locationCode, int level);
+
+    // Valid leafs inside the block along one of its sides
+    void CollectSide(uint64_t locationCode, int level, int side, std::vector<Quadrant>& leafs);
+
+    int GetTerrain(uint64_t x, uint64_t y);
+
+    void Store(uint64_t locationCode, int level, int terrain);
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <vector>
+
+#include "LazyQuadtree.hpp"
+#include "Quadtree.hpp"
+
+/**
+ * A* over a LazyQuadtree. Leafs are found as the search expands, so
+ * only the blocks around the explored area are ever read from the grid.
+ * Edge costs match AstarGraph on the same grid and terrain costs.
+ */
+class LazySearch {
+public:
+    // Returns a list of x y coords, empty if there is no path
+    std::vector<int> GetPath(LazyQuadtree& quadtree, int fromX, int fromY, int toX, int toY);
+
+    // Cost per unit length in each terrain class as in AstarGraph
+    void SetTerrainCosts(const std::vector<float>& terrainCosts);
+
+    int GetNumExpanded() const {
+        return numExpanded;
+    }
+
+private:
+    int numExpanded = 0;
+
+    std::vector<float> terrainCosts;
+    std::vector<Quadrant> neighbors;
+
+    float GetTerrainCost(int terrain) const {
+        return terrain < terrainCosts.size() ? terrainCosts[terrain] : 1.0f;
+    }
+};
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <ankerl/unordered_dense.h>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "Quadtree.hpp"
+
+/**
+ * Temporary obstacles and costs laid over the leafs of a built quadtree.
+ *
+ * Blocked leafs are a bitset and extra costs a sparse map, both indexed
+ * by leaf, so moving units can be marked every tick without rebuilding.
+ * Points and rectangles are resolved to leafs by point location, a
+ * rectangle marks every valid leaf it overlaps. The overlay remembers the
+ * tree it was sized for, searches fail on a tree it was not reset for.
+ */
+class ObstacleOverlay {
+public:
+    // Sizes the overlay to the leafs of the quadtree and clears it,
+    // call again after every rebuild
+    void Reset(const Quadtree& quadtree);
+
+    // Removes every mark but keeps the size
+    void Clear();
+
+    // Leafs outside the tree the overlay was reset for are ignored
+    void BlockLeaf(int leaf) {
+        if (leaf < 0 || leaf >= numLeafs) return;
+
+        blocked[leaf >> 6] |= (uint64_t)1 << (leaf & 63);
+    }
+
+    void BlockPoint(const Quadtree& quadtree, int x, int y);
+    void BlockRect(const Quadtree& quadtree, int x, int y, int width, int height);
+
+    // Extra cost of entering the leaf, added to any cost already there
+    void AddCost(int leaf, float cost);
+    void AddCostPoint(const Quadtree& quadtree, int x, int y, float cost);
+    void AddCostRect(const Quadtree& quadtree, int x, int y, int width, int height, float cost);
+
+    // False once the quadtree was rebuilt without calling Reset
+    bool IsCurrent(const Quadtree& quadtree) const {
+        return quadtree.GetVersion() == version && (int)quadtree.GetLeafs().size() == numLeafs;
+    }
+
+    bool IsBlocked(int leaf) const {
+        return (blocked[leaf >> 6] >> (leaf & 63)) & 1;
+    }
+
+    float GetCost(int leaf) const {
+        if (costs.empty()) return 0;
+
+        const auto iterator = costs.find(leaf);
+        return iterator != costs.end() ? iterator->second : 0;
+    }
+
+private:
+    // Version and leaf count of the quadtree passed to Reset
+    uint64_t version = 0;
+    int numLeafs = 0;
+
+    std::vector<uint64_t> blocked;
+    ankerl::unordered_dense::map<int, float> costs;
+
+    // Calls function once for every valid leaf overlapping the rectangle
+    void ForEachLeaf(
+        const Quadtree& quadtree, int x, int y, int width, int height,
+        const std::function<void(int)>& function) const;
+};
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <functional>
+
+namespace Parallel {
+    int GetNumThreads();
+
+    // Runs function(i) for i in [0, count) across the worker threads.
+    // Runs serially on the web build, which has no thread support.
+    void For(int count, const std::function<void(int)>& function);
+
+    // Runs function(i, thread) for i in [0, count) on numThreads threads.
+    // Each thread starts on its own contiguous range of indices and steals
+    // the back half of the largest remaining range once it runs dry.
+    void ForStealing(int count, int numThreads, const std::function<void(int, int)>& function);
+};
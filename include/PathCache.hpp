@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <vector>
+
+#include <ankerl/unordered_dense.h>
+
+#include "Quadtree.hpp"
+
+/**
+ * Caches optimal leaf paths by the leafs they cross, evicting the least
+ * recently used ones to stay within a memory budget.
+ *
+ * Any two leafs on a cached path are answered by the part between them.
+ * Leafs are identified by LeafKey, so a cached path survives a rebuild
+ * exactly when every leaf of its corridor survives it.
+ */
+class PathCache {
+public:
+    PathCache(size_t memoryBudget);
+
+    // Fills leafPath with the leaf indices from fromLeaf to toLeaf, false on a miss
+    bool Lookup(const Quadtree& quadtree, int fromLeaf, int toLeaf, std::vector<int>& leafPath);
+
+    // Stores the leaf indices of an optimal path in quadtree
+    void Insert(const Quadtree& quadtree, const std::vector<int>& leafPath);
+
+    // Drops every path crossing a leaf that is not in quadtree or changed
+    // its terrain class. Lookup and Insert call this when the quadtree
+    // version changes, call Clear after changing the terrain costs.
+    void Revalidate(const Quadtree& quadtree);
+
+    void Clear();
+
+    size_t GetMemoryUsage() const {
+        return memoryUsage;
+    }
+
+    int GetNumHits() const {
+        return numHits;
+    }
+
+    int GetNumMisses() const {
+        return numMisses;
+    }
+
+    float GetHitRate() const {
+        return numHits + numMisses > 0 ? (float)numHits / (numHits + numMisses) : 0;
+    }
+
+private:
+    struct CacheEntry {
+        std::vector<LeafKey> leafs;
+        std::list<int>::iterator lruIterator;
+        size_t memory;
+    };
+
+    // Where a leaf appears on a cached path
+    struct Occurrence {
+        int entry;
+        int position;
+    };
+
+    size_t memoryBudget;
+    size_t memoryUsage;
+    int numHits;
+    int numMisses;
+
+    uint64_t version;
+    int nextEntry;
+
+    // Most recently used at the front
+    std::list<int> lru;
+    ankerl::unordered_dense::map<int, CacheEntry> entries;
+    ankerl::unordered_dense::map<LeafKey, std::vector<Occurrence>, LeafKeyHash> occurrences;
+
+    std::mutex mutex;
+
+    void DropStale(const Quadtree& quadtree);
+    void Erase(int entry);
+    void Evict();
+};
@@ -33,10 +33,11 @@ struct QuadrantIdentifier {
  */
 class Quadrant {
 public:
-    Quadrant(uint64_t locationCode, int level, bool isValid) :
+    // A bool for terrain gives the blocked or the default class
+    Quadrant(uint64_t locationCode, int level, int terrain) :
         locationCode(locationCode),
         level(level),
-        isValid(isValid) 
+        terrain(terrain) 
     {}
 
     int GetX() const {
@@ -56,13 +57,55 @@ public:
     }
 
     bool IsValid() const {
-        return isValid;
+        return terrain != 0;
+    }
+
+    int GetTerrain() const {
+        return terrain;
     }
 
 private:
     int level;
     uint64_t locationCode;
-    bool isValid;
+    uint8_t terrain;
+};
+
+
+/**
+ * Names a leaf by its block and terrain class, so the same leaf can be
+ * found again in a rebuilt tree. A leaf that only changed its class no
+ * longer matches.
+ */
+struct LeafKey {
+    uint64_t locationCode;
+    int level;
+    int terrain;
+
+    LeafKey() : locationCode(0), level(-1), terrain(0) {}
+
+    explicit LeafKey(const Quadrant& leaf) :
+        locationCode(leaf.GetCode()),
+        level(leaf.GetLevel()),
+        terrain(leaf.GetTerrain())
+    {}
+
+    bool operator==(const LeafKey& other) const {
+        return locationCode == other.locationCode && level == other.level && terrain == other.terrain;
+    }
+
+    bool operator!=(const LeafKey& other) const {
+        return !(*this == other);
+    }
+};
+
+
+struct LeafKeyHash {
+    using is_avalanching = void;
+
+    uint64_t operator()(const LeafKey& key) const {
+        static_assert(sizeof(LeafKey) == sizeof(uint64_t) + 2 * sizeof(int), "LeafKey is hashed as raw bytes");
+        return ankerl::unordered_dense::detail::wyhash::hash(&key, sizeof(LeafKey));
+    }
 };
 
 
@@ -72,7 +115,26 @@ public:
 
     void Init(int resolution);
 
+    // Rectangular grids, the area beyond width and height is blocked
+    void Init(int width, int height);
+
+    // Sets the resolution directly as log2 of the side length
+    void SetResolution(int resolution);
+
     void Build(const GridEnvironment& grid, int maxLevel);
+
+    // Lets a block become one leaf once tolerance of its cells agree, 1
+    // gives the tree of Build. Valid cells of a leaf must still share one
+    // terrain class. With isConservative a block holding any blocked cell
+    // never becomes valid. Below 1, blocks at maxLevel that still disagree
+    // take the majority, or blocked when conservative.
+    void BuildLossy(const GridEnvironment& grid, int maxLevel, float tolerance, bool isConservative = false);
+
+    // Incremental construction from known leafs (e.g. when decoding a stream).
+    // Call Clear, AddLeaf for every leaf, then Finalize to rebuild the adjacency.
+    void Clear();
+    void AddLeaf(uint64_t locationCode, int level, int terrain);
+    void Finalize(int maxLevel);
     
     const std::vector<Quadrant>& GetLeafs() const {
         return leafs;
@@ -82,6 +144,15 @@ public:
         return resolution;
     }
 
+    int GetMaxLevel() const {
+        return maxLevel;
+    }
+
+    // Unique per finalized tree, changes on every build
+    uint64_t GetVersion() const {
+        return version;
+    }
+
     const std::vector<std::vector<int>>& GetGraph() const {
         return quadtreeGraph;
     }
@@ -89,6 +160,15 @@ public:
     // Returns the index of the quadrant
     int QueryValidRegion(uint32_t x, uint32_t y) const;
 
+    // Returns the index of the leaf containing the point whether valid or not, or -1
+    int QueryRegion(uint32_t x, uint32_t y) const;
+
+    // Returns the index of the leaf with exactly this code and level, or -1
+    int FindLeaf(uint64_t locationCode, int level) const;
+
+    // Returns the index of the leaf with this code, level and terrain class, or -1
+    int FindLeaf(const LeafKey& key) const;
+
 
 private:
 
@@ -99,16 +179,18 @@ private:
 
     int resolution;
     int maxLevel;
+    uint64_t version;
 
     std::vector<Quadrant> leafs;
 
     std::vector<std::vector<int>> quadtreeGraph;
     ankerl::unordered_dense::map<uint64_t, int> leafIndex;
         
-    void SubdivideRegionLarge(uint64_t fromIndex, uint64_t lowerBound, bool oldValid, int maxLevel);
-    void SubdivideRegionSmall(uint64_t fromIndex, uint64_t upperBound, bool oldValid, int maxLevel);
+    void SubdivideRegionLarge(uint64_t fromIndex, uint64_t lowerBound, int oldTerrain, int maxLevel);
+    void SubdivideRegionSmall(uint64_t fromIndex, uint64_t upperBound, int oldTerrain, int maxLevel);
     
     void BuildRegion(const GridEnvironment& grid, int maxLevel);
+    void BuildRegionLossy(const GridEnvironment& grid, int maxLevel, float tolerance, bool isConservative);
     void BuildLevelDifferences(ankerl::unordered_dense::map<uint64_t, QuadrantIdentifier> &mapIdentifiers, int maxLevel);
     void BuildGraph(const ankerl::unordered_dense::map<uint64_t, QuadrantIdentifier> &mapIdentifiers, int maxLevel);
 
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "AstarGraph.hpp"
+#include "GridEnvironment.hpp"
+#include "Quadtree.hpp"
+
+/**
+ * View of one tile of a larger world grid, clipped to the world.
+ * Tiles on the world border are smaller than tileSize, the quadtree
+ * treats the rest of the tile as blocked.
+ */
+class TileGridEnvironment : public GridEnvironment {
+public:
+    void Init(const GridEnvironment& world, size_t originX, size_t originY, size_t tileSize) {
+        this->world = &world;
+        this->originX = originX;
+        this->originY = originY;
+        gridWidth = std::min(tileSize, world.GetWidth() - originX);
+        gridHeight = std::min(tileSize, world.GetHeight() - originY);
+    }
+
+    const bool IsValid(int i) const;
+    const int GetTerrain(int i) const;
+
+private:
+    const GridEnvironment* world;
+    size_t originX;
+    size_t originY;
+};
+
+
+/**
+ * A valid leaf touching a tile border, as an interval along that border
+ */
+struct TilePortal {
+    int node;
+    int offset;
+    int length;
+};
+
+
+/**
+ * One tile of the forest, owns its own quadtree and graph.
+ * Tiles are stitched at search time by overlapping border portals,
+ * so every tile can be built and rebuilt on its own.
+ */
+class QuadtreeTile {
+public:
+    // Terrain costs weight the tile graph as in AstarGraph::SetTerrainCosts
+    void Build(
+      const GridEnvironment& world, int tileX, int tileY, int tileSize, int maxLevel,
+      const std::vector<float>& terrainCosts);
+
+    // Adopts an already built quadtree (e.g. decoded from a stream)
+    void Load(int tileX, int tileY, int tileSize, Quadtree&& quadtree, const std::vector<float>& terrainCosts);
+
+    int GetTileX() const {
+        return tileX;
+    }
+
+    int GetTileY() const {
+        return tileY;
+    }
+
+    const Quadtree& GetQuadtree() const {
+        return quadtree;
+    }
+
+    const AstarGraph& GetGraph() const {
+        return graph;
+    }
+
+    // Changes whenever the tile at this position is rebuilt, node numbers
+    // only mean the same leafs between tiles of the same version
+    uint32_t GetVersion() const {
+        return version;
+    }
+
+    void SetVersion(uint32_t version) {
+        this->version = version;
+    }
+
+    // side: SOUTH, NORTH, WEST, EAST as in Quadtree
+    const std::vector<TilePortal>& GetPortals(int side) const {
+        return portals[side];
+    }
+
+    // Appends the portals on a side overlapping [offset, offset + length)
+    void FindPortals(int side, int offset, int length, std::vector<TilePortal>& result) const;
+
+    size_t GetMemoryUsage() const;
+
+private:
+    int tileX;
+    int tileY;
+    int tileSize;
+    uint32_t version = 0;
+
+    Quadtree quadtree;
+    AstarGraph graph;
+
+    std::vector<TilePortal> portals[4];
+
+    void BuildPortals();
+};
+
+
+/**
+ * Source of tiles for searching a tiled world
+ */
+class TileProvider {
+public:
+    virtual std::shared_ptr<const QuadtreeTile> GetTile(int tileX, int tileY) = 0;
+
+    // Hint that a search is about to run between the two world positions
+    virtual void Prefetch(int, int, int, int) {}
+
+    int GetTileSize() const {
+        return tileSize;
+    }
+
+    int GetTilesX() const {
+        return tilesX;
+    }
+
+    int GetTilesY() const {
+        return tilesY;
+    }
+
+    // Cost per unit length in each terrain class for tiles built or loaded
+    // from now on and for the portal edges between tiles
+    void SetTerrainCosts(const std::vector<float>& terrainCosts) {
+        this->terrainCosts.resize(terrainCosts.size());
+
+        for (int i = 0; i < terrainCosts.size(); ++i) {
+            this->terrainCosts[i] = std::max(1.0f, terrainCosts[i]);
+        }
+    }
+
+    const std::vector<float>& GetTerrainCosts() const {
+        return terrainCosts;
+    }
+
+protected:
+    int tileSize;
+    int tilesX;
+    int tilesY;
+
+    std::vector<float> terrainCosts;
+};
+
+
+/**
+ * World split into fixed-size tiles, each with its own quadtree,
+ * for maps too large for a single quadtree.
+ */
+class QuadtreeForest : public TileProvider {
+public:
+    void Init(size_t worldWidth, size_t worldHeight, int tileSize, int maxLevel);
+
+    // Builds every tile in parallel
+    void Build(const GridEnvironment& world);
+
+    void BuildTile(const GridEnvironment& world, int tileX, int tileY);
+
+    // Rebuilds the tiles overlapping an edited rectangle
+    void Rebuild(const GridEnvironment& world, int x, int y, int width, int height);
+
+    std::shared_ptr<const QuadtreeTile> GetTile(int tileX, int tileY);
+
+private:
+    int maxLevel;
+
+    std::vector<std::shared_ptr<const QuadtreeTile>> tiles;
+};
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+
+#include "Quadtree.hpp"
+
+/**
+ * Compact streaming encoding of a quadtree for transport and archival.
+ *
+ * Leafs are written in Morton order in chunks. Every chunk stores the gap
+ * between a leaf's code and the end of the previous leaf as a varint (zero
+ * for a fully tiled region), followed by the levels and terrain classes
+ * bit-packed at 10 bits per leaf. Adjacency is not stored; it is rebuilt
+ * from level differences on load. Streams of the older 7 bit format with
+ * a valid flag still decode.
+ */
+namespace QuadtreeStream {
+    // Leafs per chunk, bounds the memory used on either side of the stream
+    constexpr int CHUNK_SIZE = 4096;
+
+    bool Encode(const Quadtree& quadtree, std::ostream& stream);
+
+    // Leaves quadtree unchanged when the stream is rejected
+    bool Decode(Quadtree& quadtree, std::istream& stream);
+};
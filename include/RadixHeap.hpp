@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/**
+ * Monotone priority queue on unsigned integer keys.
+ *
+ * Keys may never go below the last popped key, which A* with a consistent
+ * heuristic guarantees. Bucket i holds keys whose highest bit differing
+ * from the last popped key is bit i - 1, so a push is a bit scan and a
+ * pop only redistributes one bucket into lower ones. Each item moves down
+ * at most 32 times over its lifetime, no sifting happens.
+ *
+ * Items are not deduplicated, a caller that improves a key pushes again
+ * and skips the stale copy when it comes out.
+ */
+class RadixHeap {
+public:
+    // Keys below the last popped key are raised to it
+    void Push(uint32_t key, int uniqueId);
+
+    // Smallest key, only valid after GetSize() > 0
+    uint32_t TopKey();
+
+    // Item with the smallest key, only valid after GetSize() > 0
+    int TopItemID();
+
+    // removes top of heap
+    void Pop();
+
+    unsigned int GetSize() const {
+        return size;
+    }
+
+    // Empties the heap but keeps the bucket storage
+    void Clear();
+
+private:
+    static constexpr int NUM_BUCKETS = 33;
+
+    std::vector<std::pair<uint32_t, int>> buckets[NUM_BUCKETS];
+    uint32_t last = 0;
+    unsigned int size = 0;
+
+    int GetBucket(uint32_t key) const {
+        return key == last ? 0 : 32 - __builtin_clz(key ^ last);
+    }
+
+    // Makes bucket 0 hold the smallest keys
+    void Refill();
+};
+
+
+inline void RadixHeap::Push(uint32_t key, int uniqueId) {
+    if (key < this->last) {
+        key = this->last;
+    }
+
+    this->buckets[this->GetBucket(key)].emplace_back(key, uniqueId);
+    this->size++;
+}
+
+
+inline uint32_t RadixHeap::TopKey() {
+    this->Refill();
+    return this->buckets[0].back().first;
+}
+
+
+inline int RadixHeap::TopItemID() {
+    this->Refill();
+    return this->buckets[0].back().second;
+}
+
+
+inline void RadixHeap::Pop() {
+    if (this->size == 0) return;
+
+    this->Refill();
+    this->buckets[0].pop_back();
+    this->size--;
+}
+
+
+inline void RadixHeap::Refill() {
+    if (this->buckets[0].size() > 0) return;
+
+    int i = 1;
+    while (this->buckets[i].size() == 0) {
+        ++i;
+    }
+
+    uint32_t minKey = this->buckets[i][0].first;
+    for (const std::pair<uint32_t, int>& item : this->buckets[i]) {
+        if (item.first < minKey) {
+            minKey = item.first;
+        }
+    }
+
+    // Every key in the bucket now differs from the new last below bit i - 1
+    this->last = minKey;
+
+    for (const std::pair<uint32_t, int>& item : this->buckets[i]) {
+        this->buckets[this->GetBucket(item.first)].push_back(item);
+    }
+
+    this->buckets[i].clear();
+}
+
+
+inline void RadixHeap::Clear() {
+    for (int i = 0; i < NUM_BUCKETS; ++i) {
+        this->buckets[i].clear();
+    }
+
+    this->last = 0;
+    this->size = 0;
+}
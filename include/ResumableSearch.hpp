@@ -0,0 +1,190 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <vector>
+
+#include "ArcFlags.hpp"
+#include "AstarGraph.hpp"
+#include "ClearanceMap.hpp"
+#include "LandmarkHeuristic.hpp"
+#include "ObstacleOverlay.hpp"
+#include "Quadtree.hpp"
+
+enum SearchStatus {
+    SEARCH_IDLE,
+    SEARCH_RUNNING,
+    SEARCH_FOUND,
+    SEARCH_NOT_FOUND,
+    SEARCH_CANCELLED
+};
+
+
+/**
+ * A* search that runs in slices. The open list and workspace are kept
+ * between Step calls, so a long search can be spread over many frames.
+ * The quadtree and graph must stay unchanged until the search ends.
+ * Landmarks, arc flags, the overlay and the clearance map apply as in
+ * AstarSearch and are read when the search starts.
+ */
+class ResumableSearch {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Returns false and ends the search when an endpoint is not in a valid
+    // leaf or the agent does not fit there
+    bool Start(
+      const Quadtree& quadtree, const AstarGraph& graph,
+      int fromX, int fromY, int toX, int toY, float agentRadius = 0.0f);
+
+    void SetLandmarks(const LandmarkHeuristic* landmarks) {
+        this->landmarks = landmarks;
+    }
+
+    void SetArcFlags(const ArcFlags* arcFlags) {
+        this->arcFlags = arcFlags;
+    }
+
+    void SetOverlay(const ObstacleOverlay* overlay) {
+        this->overlay = overlay;
+    }
+
+    void SetClearance(const ClearanceMap* clearance) {
+        this->clearance = clearance;
+    }
+
+    // Expands up to maxExpansions nodes
+    SearchStatus Step(int maxExpansions);
+
+    // Expands nodes until the deadline passes
+    SearchStatus Step(Clock::time_point deadline);
+
+    void Cancel();
+
+    SearchStatus GetStatus() const {
+        return status;
+    }
+
+    bool IsRunning() const {
+        return status == SEARCH_RUNNING;
+    }
+
+    // The path once found, or while running the path to the expanded node
+    // closest to the goal. Returns a list of x y coords.
+    std::vector<int> GetPath() const;
+
+    int GetNumExpanded() const {
+        return numExpanded;
+    }
+
+private:
+    struct QueueEntry {
+        float key;
+        int node;
+
+        bool operator>(const QueueEntry& other) const {
+            return key > other.key;
+        }
+    };
+
+    const Quadtree* quadtree = nullptr;
+    const AstarGraph* graph = nullptr;
+
+    const LandmarkHeuristic* landmarks = nullptr;
+    const ArcFlags* arcFlags = nullptr;
+    const ObstacleOverlay* overlay = nullptr;
+    const ClearanceMap* clearance = nullptr;
+
+    SearchStatus status = SEARCH_IDLE;
+
+    // Fixed for the whole search, see Start
+    uint64_t goalMask;
+    float agentRadius;
+
+    int fromX, fromY, toX, toY;
+    int fromNode, toNode;
+
+    // Expanded node with the smallest heuristic
+    int bestNode;
+    float bestEstimate;
+
+    int numExpanded = 0;
+
+    std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>> openSet;
+
+    // Stamped so starting a new search does not clear them
+    std::vector<float> gScores;
+    std::vector<int> parents;
+    std::vector<unsigned int> visited;
+    std::vector<unsigned int> closed;
+    unsigned int stamp = 0;
+
+    float Estimate(int node) const;
+
+    // Expands the top of the open list, false once the search has ended
+    bool Expand();
+};
+
+
+/**
+ * Interleaves many resumable searches within a time budget per frame,
+ * giving every running search a slice of expansions in turn.
+ */
+class SearchScheduler {
+public:
+    static constexpr int SLICE_EXPANSIONS = 128;
+
+    // Returns the id of the new search, -1 when an endpoint is not in a valid leaf
+    int Submit(
+      const Quadtree& quadtree, const AstarGraph& graph,
+      int fromX, int fromY, int toX, int toY, float agentRadius = 0.0f);
+
+    // Handed to every search submitted from now on
+    void SetLandmarks(const LandmarkHeuristic* landmarks) {
+        this->landmarks = landmarks;
+    }
+
+    void SetArcFlags(const ArcFlags* arcFlags) {
+        this->arcFlags = arcFlags;
+    }
+
+    void SetOverlay(const ObstacleOverlay* overlay) {
+        this->overlay = overlay;
+    }
+
+    void SetClearance(const ClearanceMap* clearance) {
+        this->clearance = clearance;
+    }
+
+    // Runs the searches round robin until they finish or the deadline passes
+    void Update(ResumableSearch::Clock::time_point deadline);
+
+    void Cancel(int id);
+
+    // Frees the slot of a finished or cancelled search, ids that are not
+    // live are ignored
+    void Release(int id);
+
+    // Cancels every search, call before the quadtree or graph change
+    void CancelAll();
+
+    const ResumableSearch& GetSearch(int id) const {
+        return *searches[id];
+    }
+
+    int GetNumRunning() const;
+
+private:
+    std::vector<std::unique_ptr<ResumableSearch>> searches;
+    std::vector<bool> isLive;
+    std::vector<int> freeIds;
+    int next = 0;
+
+    const LandmarkHeuristic* landmarks = nullptr;
+    const ArcFlags* arcFlags = nullptr;
+    const ObstacleOverlay* overlay = nullptr;
+    const ClearanceMap* clearance = nullptr;
+};
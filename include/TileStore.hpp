@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <ankerl/unordered_dense.h>
+
+#include "GridEnvironment.hpp"
+#include "QuadtreeForest.hpp"
+
+/**
+ * Tile file layout: header, offset table with one entry per tile plus an end
+ * marker, then every tile encoded with QuadtreeStream.
+ */
+namespace TileStore {
+    // Builds the world one tile at a time and appends every tile to the file,
+    // only a handful of tiles are in memory at once
+    bool Write(const char* path, const GridEnvironment& world, int tileSize, int maxLevel);
+};
+
+
+/**
+ * Pages tiles in from a tile file on demand and evicts the least recently
+ * used ones to stay within a memory budget.
+ */
+class TileCache : public TileProvider {
+public:
+    TileCache();
+
+    bool Open(const char* path, size_t memoryBudget);
+    void Close();
+
+    std::shared_ptr<const QuadtreeTile> GetTile(int tileX, int tileY);
+
+    // Pages in the tiles along the straight line between the two positions,
+    // stops at the first tile that does not fit in the budget
+    void Prefetch(int fromX, int fromY, int toX, int toY);
+
+    size_t GetMemoryUsage() const {
+        return memoryUsage;
+    }
+
+    int GetNumHits() const {
+        return numHits;
+    }
+
+    int GetNumLoads() const {
+        return numLoads;
+    }
+
+    ~TileCache();
+
+private:
+    struct CacheEntry {
+        std::shared_ptr<const QuadtreeTile> tile;
+        std::list<int>::iterator lruIterator;
+        size_t memory;
+    };
+
+    int file;
+    int maxLevel;
+
+    std::vector<uint64_t> offsets;
+
+    size_t memoryBudget;
+    size_t memoryUsage;
+    int numHits;
+    int numLoads;
+
+    // Most recently used at the front
+    std::list<int> lru;
+    ankerl::unordered_dense::map<int, CacheEntry> entries;
+
+    // Guards the cache, not the file, reads go through pread
+    std::mutex mutex;
+
+    // Returns the cached tile or loads it, without canEvict a loaded tile
+    // that does not fit in the budget is dropped and nullptr returned
+    std::shared_ptr<const QuadtreeTile> FetchTile(int tileIndex, bool canEvict);
+
+    // Reads and decodes the tile, takes no lock
+    std::shared_ptr<const QuadtreeTile> LoadTile(int tileIndex) const;
+
+    void Evict(int keepIndex);
+};
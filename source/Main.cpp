@@ -1,3 +1,4 @@
+#include <chrono>
 #include <cmath>
 #include <string>
 #define RAYLIB_IMPLEMENTATION
@@ -9,7 +10,9 @@
 #include "DebugRenderer.hpp"
 #include "ImageGridEnvironment.hpp"
 #include "AstarGraph.hpp"
-#include "AstarSearch.hpp"
+#include "GoalRootedSearch.hpp"
+#include "IncrementalSearch.hpp"
+#include "ResumableSearch.hpp"
 #include "Endpoint.hpp"
 
 
@@ -19,11 +22,18 @@ bool quadtreeRender;
 int maxLevel;
 
 bool pathRender;
+bool pathMoved;
+bool goalMoved;
+
+// Time the path search may take per frame, a longer search continues next frame
+const std::chrono::milliseconds pathBudget(4);
 
 Drawpad drawpad;
 Quadtree quadtree;
 AstarGraph astarGraph;
-AstarSearch astarSearch;
+ResumableSearch pathSearch;
+IncrementalSearch pathReplanner;
+GoalRootedSearch goalTree;
 DebugRenderer debugRenderer;
 ImageGridEnvironment grid;
 
@@ -40,14 +50,16 @@ void Init() {
     InitWindow(WINDOW_W, WINDOW_H, WINDOW_N);
     
 
-    quadtree.Init(WINDOW_W);
+    quadtree.Init(WINDOW_W, WINDOW_H);
     debugRenderer.Init();
     drawpad.Init();
-    grid.Init(drawpad.GetPixels(), WINDOW_H, WINDOW_H);
+    grid.Init(drawpad.GetPixels(), WINDOW_W, WINDOW_H);
 
     isGameEnd = false;
     quadtreeBuild = true;
     quadtreeRender = true;
+    pathMoved = true;
+    goalMoved = true;
     
     maxLevel = std::log2(WINDOW_W);
 }
@@ -89,12 +101,15 @@ void Input() {
         Vector2 mousePosition = GetMousePosition();
         start.SetPosition(mousePosition.x, mousePosition.y);
         pathRender = true;
+        pathMoved = true;
     }
 
     if (IsKeyPressed(KEY_W)) {
         Vector2 mousePosition = GetMousePosition();
         end.SetPosition(mousePosition.x, mousePosition.y);
         pathRender = true;
+        pathMoved = true;
+        goalMoved = true;
     }
 
     drawpad.Input();
@@ -107,12 +122,41 @@ void Update(float deltaTime) {
         astarGraph.Build(quadtree);
         debugRenderer.Update(quadtree, astarGraph);
         quadtreeBuild = false;
+
+        // The graph changed under the search, start over
+        if (pathSearch.IsRunning()) {
+            pathRender = true;
+        }
+    }
+
+    if (pathRender && !pathMoved && !pathSearch.IsRunning()) {
+        // Same endpoints on an edited map, repair the previous plan
+        debugRenderer.UpdatePath(pathReplanner.GetPath(quadtree, astarGraph, start.GetX(), start.GetY(), end.GetX(), end.GetY()));
+        pathRender = false;
+    }
+
+    if (pathRender && !goalMoved && !pathSearch.IsRunning()) {
+        // Only the start moved, grow the search tree kept around the goal
+        debugRenderer.UpdatePath(goalTree.GetPath(quadtree, astarGraph, start.GetX(), start.GetY(), end.GetX(), end.GetY()));
+        pathRender = false;
+        pathMoved = false;
     }
 
     if (pathRender) {
-        const std::vector<int>& path = astarSearch.GetPath(quadtree, astarGraph, start.GetX(), start.GetY(), end.GetX(), end.GetY());
-        debugRenderer.UpdatePath(path);
+        pathSearch.Start(quadtree, astarGraph, start.GetX(), start.GetY(), end.GetX(), end.GetY());
         pathRender = false;
+        pathMoved = false;
+        goalMoved = false;
+
+        if (!pathSearch.IsRunning()) {
+            debugRenderer.UpdatePath(pathSearch.GetPath());
+        }
+    }
+
+    // Shows the best partial path while the search is spread over frames
+    if (pathSearch.IsRunning()) {
+        pathSearch.Step(ResumableSearch::Clock::now() + pathBudget);
+        debugRenderer.UpdatePath(pathSearch.GetPath());
     }
     
     drawpad.Update();
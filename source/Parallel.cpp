@@ -0,0 +1,135 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "Parallel.hpp"
+
+namespace Parallel {
+
+    int GetNumThreads() {
+#ifdef PLATFORM_WEB
+        return 1;
+#else
+        const int numThreads = std::thread::hardware_concurrency();
+        return numThreads > 0 ? numThreads : 1;
+#endif
+    }
+
+
+    void For(int count, const std::function<void(int)>& function) {
+        const int numThreads = std::min(GetNumThreads(), count);
+
+        if (numThreads <= 1) {
+            for (int i = 0; i < count; ++i) {
+                function(i);
+            }
+            return;
+        }
+
+        std::atomic<int> next(0);
+
+        auto worker = [&]() {
+            for (int i = next++; i < count; i = next++) {
+                function(i);
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (int t = 1; t < numThreads; ++t) {
+            threads.emplace_back(worker);
+        }
+
+        worker();
+
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    }
+
+
+    void ForStealing(int count, int numThreads, const std::function<void(int, int)>& function) {
+#ifdef PLATFORM_WEB
+        numThreads = 1;
+#endif
+        numThreads = std::max(1, std::min(numThreads, count));
+
+        if (numThreads == 1) {
+            for (int i = 0; i < count; ++i) {
+                function(i, 0);
+            }
+            return;
+        }
+
+        // Range of every thread packed as begin << 32 | end, the owner takes from
+        // the front and thieves cut off the back, both through compare exchange
+        std::vector<std::atomic<uint64_t>> ranges(numThreads);
+
+        for (int t = 0; t < numThreads; ++t) {
+            const uint64_t begin = (uint64_t)count * t / numThreads;
+            const uint64_t end = (uint64_t)count * (t + 1) / numThreads;
+            ranges[t] = begin << 32 | end;
+        }
+
+        auto worker = [&](int thread) {
+            std::atomic<uint64_t>& range = ranges[thread];
+
+            while (true) {
+                uint64_t current = range.load();
+
+                while ((uint32_t)(current >> 32) < (uint32_t)current) {
+                    const uint64_t next = current + ((uint64_t)1 << 32);
+
+                    if (range.compare_exchange_weak(current, next)) {
+                        function(current >> 32, thread);
+                        current = range.load();
+                    }
+                }
+
+                // Steal from the thread with the most work left
+                int victim = -1;
+                uint32_t victimSize = 0;
+
+                for (int t = 0; t < numThreads; ++t) {
+                    const uint64_t other = ranges[t].load();
+                    const uint32_t size = (uint32_t)other - (uint32_t)(other >> 32);
+
+                    if ((uint32_t)(other >> 32) < (uint32_t)other && size > victimSize) {
+                        victim = t;
+                        victimSize = size;
+                    }
+                }
+
+                if (victim == -1) return;
+
+                uint64_t other = ranges[victim].load();
+                const uint32_t begin = other >> 32;
+                const uint32_t end = other;
+
+                if (begin >= end) continue;
+
+                const uint32_t middle = begin + (end - begin) / 2;
+
+                // A single item is taken whole
+                const uint64_t left = (uint64_t)begin << 32 | middle;
+
+                if (ranges[victim].compare_exchange_strong(other, left)) {
+                    range = (uint64_t)middle << 32 | end;
+                }
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (int t = 1; t < numThreads; ++t) {
+            threads.emplace_back(worker, t);
+        }
+
+        worker(0);
+
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    }
+}
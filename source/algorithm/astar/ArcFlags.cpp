@@ -0,0 +1,126 @@
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include "ArcFlags.hpp"
+#include "AstarGraph.hpp"
+#include "Parallel.hpp"
+#include "Quadtree.hpp"
+
+
+namespace {
+    constexpr float INFINITE = std::numeric_limits<float>::max();
+
+    struct QueueEntry {
+        float key;
+        int node;
+
+        bool operator>(const QueueEntry& other) const {
+            return key > other.key;
+        }
+    };
+}
+
+
+void ArcFlags::Build(const Quadtree& quadtree, const AstarGraph& graph, int numRegions) {
+    this->Clear();
+
+    const std::vector<Quadrant>& leafs = quadtree.GetLeafs();
+    const std::vector<AstarNode>& nodes = graph.GetNodes();
+    const std::vector<AstarEdge>& edges = graph.GetEdges();
+
+    // Partition the valid leafs along the Morton order
+    std::vector<int> order;
+    for (int i = 0; i < nodes.size(); ++i) {
+        if (leafs[i].IsValid()) order.push_back(i);
+    }
+
+    std::sort(order.begin(), order.end(), [&](int a, int b) {
+        return leafs[a].GetCode() < leafs[b].GetCode();
+    });
+
+    this->numRegions = std::max(1, std::min({numRegions, MAX_REGIONS, (int)order.size()}));
+
+    regions.assign(nodes.size(), 0);
+    flags.assign(edges.size(), 0);
+
+    for (int i = 0; i < order.size(); ++i) {
+        regions[order[i]] = (uint64_t)i * this->numRegions / order.size();
+    }
+
+    // Edges inside a region are always kept, and every region is entered through
+    // one of its boundary nodes
+    std::vector<int> boundary;
+
+    for (int i = 0; i < nodes.size(); ++i) {
+        bool isBoundary = false;
+
+        for (int e = nodes[i].GetEdgeIndex(); e < nodes[i].GetEdgeIndex() + nodes[i].GetNumEdges(); ++e) {
+            if (regions[edges[e].GetNodeIdB()] == regions[i]) {
+                flags[e] |= this->GetRegionMask(i);
+            } else {
+                isBoundary = true;
+            }
+        }
+
+        if (isBoundary) boundary.push_back(i);
+    }
+
+    // Dijkstra from every boundary node. The graph is symmetric, so an edge u -> v
+    // lies on a shortest path to the boundary node when d(v) + w = d(u).
+    Parallel::For(boundary.size(), [&](int b) {
+        const int source = boundary[b];
+        const uint64_t mask = this->GetRegionMask(source);
+
+        std::vector<float> distances(nodes.size(), INFINITE);
+        std::vector<int> settled;
+        std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>> queue;
+
+        distances[source] = 0;
+        queue.push(QueueEntry{0, source});
+
+        while (queue.size() > 0) {
+            const QueueEntry current = queue.top();
+            queue.pop();
+
+            if (current.key > distances[current.node]) continue;
+
+            settled.push_back(current.node);
+
+            const AstarNode& node = nodes[current.node];
+
+            for (int e = node.GetEdgeIndex(); e < node.GetEdgeIndex() + node.GetNumEdges(); ++e) {
+                const int next = edges[e].GetNodeIdB();
+                const float distance = current.key + edges[e].GetDist();
+
+                if (distance < distances[next]) {
+                    distances[next] = distance;
+                    queue.push(QueueEntry{distance, next});
+                }
+            }
+        }
+
+        for (int u : settled) {
+            const AstarNode& node = nodes[u];
+            const float tolerance = distances[u] * 1e-5f + 1e-3f;
+
+            for (int e = node.GetEdgeIndex(); e < node.GetEdgeIndex() + node.GetNumEdges(); ++e) {
+                const int v = edges[e].GetNodeIdB();
+
+                if (distances[v] + edges[e].GetDist() <= distances[u] + tolerance) {
+                    __atomic_fetch_or(&flags[e], mask, __ATOMIC_RELAXED);
+                }
+            }
+        }
+    });
+}
+
+
+void ArcFlags::Clear() {
+    numRegions = 0;
+    regions.clear();
+    flags.clear();
+}
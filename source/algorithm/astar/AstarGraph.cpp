@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <vector>
 
 #include "AstarGraph.hpp"
@@ -28,7 +29,7 @@ void AstarGraph::Build(const Quadtree &quadtree) {
 
     for (int i = 0; i < quadtreeGraph.size(); ++i) {
         for (int j = 0; j < quadtreeGraph[i].size(); ++j) {
-            this->AddEdge(i, quadtreeGraph[i][j]);
+            this->AddEdge(quadtree, i, quadtreeGraph[i][j]);
         }
     }
 }
@@ -39,7 +40,16 @@ void AstarGraph::AddNode(int x, int y,int edgeIndex) {
 }
 
 
-void AstarGraph::AddEdge(int nodeIdA, int nodeIdB) {
+void AstarGraph::SetTerrainCosts(const std::vector<float>& terrainCosts) {
+    this->terrainCosts.resize(terrainCosts.size());
+
+    for (int i = 0; i < terrainCosts.size(); ++i) {
+        this->terrainCosts[i] = std::max(1.0f, terrainCosts[i]);
+    }
+}
+
+
+void AstarGraph::AddEdge(const Quadtree &quadtree, int nodeIdA, int nodeIdB) {
     if (nodeIdA >= nodes.size() && nodeIdB >= nodes.size()) {
         return;
     }
@@ -49,7 +59,20 @@ void AstarGraph::AddEdge(int nodeIdA, int nodeIdB) {
 
     const float dx = nodeB.GetX() - nodeA.GetX();
     const float dy = nodeB.GetY() - nodeA.GetY();
-    const float dist = std::sqrt(dx * dx + dy * dy);
+    float dist = std::sqrt(dx * dx + dy * dy);
+
+    if (terrainCosts.size() > 0) {
+        // The centre to centre segment crosses the shared side where it
+        // splits in proportion to the two side lengths
+        const Quadrant& quadA = quadtree.GetLeafs()[nodeIdA];
+        const Quadrant& quadB = quadtree.GetLeafs()[nodeIdB];
+        const float lengthA = 1 << (quadtree.GetResolution() - quadA.GetLevel());
+        const float lengthB = 1 << (quadtree.GetResolution() - quadB.GetLevel());
+        const float costA = quadA.GetTerrain() < terrainCosts.size() ? terrainCosts[quadA.GetTerrain()] : 1.0f;
+        const float costB = quadB.GetTerrain() < terrainCosts.size() ? terrainCosts[quadB.GetTerrain()] : 1.0f;
+
+        dist *= (lengthA * costA + lengthB * costB) / (lengthA + lengthB);
+    }
     
     edges[nodeA.GetEdgeIndex() + nodeA.GetNumEdges()] = AstarEdge(nodeIdB, dist);
     nodeA.IncrementNumEdges();
@@ -1,10 +1,13 @@
 #include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <cstdint>
+#include <cstring>
+#include <thread>
 #include <vector>
 #include <limits>
-
-#include "ankerl/unordered_dense.h"
+#include <set>
+#include <utility>
 
 #include "AstarSearch.hpp"
 #include "AstarGraph.hpp"
@@ -12,48 +15,234 @@
 #include "Heap.hpp"
 
 
+namespace {
+    uint64_t PackLabel(unsigned int stamp, float gScore) {
+        uint32_t bits;
+        std::memcpy(&bits, &gScore, sizeof(bits));
+        return (uint64_t)stamp << 32 | bits;
+    }
+
+    float UnpackScore(uint64_t label) {
+        const uint32_t bits = label;
+        float gScore;
+        std::memcpy(&gScore, &bits, sizeof(gScore));
+        return gScore;
+    }
+
+    // Radix heap keys count 1/64 pixel units
+    constexpr float FIXED_POINT_SCALE = 64.0f;
+
+    uint32_t ToFixedPoint(float cost) {
+        return (uint32_t)std::min((double)cost * FIXED_POINT_SCALE, (double)std::numeric_limits<uint32_t>::max());
+    }
+
+    // Costs are non negative, so their bits order the same way as the floats
+    uint64_t PackMeeting(float cost, int node) {
+        return PackLabel(0, cost) << 32 | (uint32_t)node;
+    }
+}
+
+
+AstarSearch::AstarSearch() : openSet(
+    [](const float& a, const float& b) -> bool {
+        return a > b;
+    }
+) {}
+
+
+void AstarSearch::PrepareWorkspace(int numNodes) {
+    if (++stamp == 0 || labels[0].size() < numNodes) {
+        for (int dir = 0; dir < 2; ++dir) {
+            labels[dir].assign(numNodes, 0);
+            parent[dir].assign(numNodes, -1);
+            closed[dir].assign(numNodes, 0);
+        }
+        stamp = 1;
+    }
+}
+
 
 // Returns a list of x y coords
 std::vector<int> AstarSearch::GetPath(const Quadtree& quadtree, const AstarGraph& graph, int fromX, int fromY, int toX, int toY) {
+    return this->GetPath(quadtree, graph, fromX, fromY, toX, toY, SearchOptions());
+}
+
+
+// Returns a list of x y coords
+std::vector<int> AstarSearch::GetPath(
+    const Quadtree& quadtree, const AstarGraph& graph,
+    int fromX, int fromY, int toX, int toY, const SearchOptions& options
+) {
     std::vector<int> path; // xyxyxy...
 
+    const int numLeafs = this->FindLeafPath(quadtree, graph, fromX, fromY, toX, toY, options);
+
+    if (numLeafs == -1) {
+        return path;
+    }
+
+    const std::vector<AstarNode>& nodes = graph.GetNodes();
+
+    path.reserve(2 * numLeafs + 4);
+    path.emplace_back(fromX);
+    path.emplace_back(fromY);
+
+    for (int leaf : leafPath) {
+        path.emplace_back(nodes[leaf].GetX());
+        path.emplace_back(nodes[leaf].GetY());
+    }
+
+    path.emplace_back(toX);
+    path.emplace_back(toY);
+
+    return path;
+}
+
+
+// Writes x y coords from the start forward, a path longer than capacity
+// keeps its first waypoints
+PathStatus AstarSearch::GetPath(
+    const Quadtree& quadtree, const AstarGraph& graph,
+    int fromX, int fromY, int toX, int toY,
+    int* coords, int capacity, int& numCoords, const SearchOptions& options
+) {
+    numCoords = 0;
+
+    const int numLeafs = this->FindLeafPath(quadtree, graph, fromX, fromY, toX, toY, options);
+
+    if (numLeafs == -1) {
+        return PATH_NOT_FOUND;
+    }
+
+    const std::vector<AstarNode>& nodes = graph.GetNodes();
+
+    // Whole waypoints only
+    const int numWaypoints = std::min(numLeafs + 2, std::max(capacity, 0) / 2);
+
+    for (int i = 0; i < numWaypoints; ++i) {
+        if (i == 0) {
+            coords[numCoords++] = fromX;
+            coords[numCoords++] = fromY;
+        } else if (i == numLeafs + 1) {
+            coords[numCoords++] = toX;
+            coords[numCoords++] = toY;
+        } else {
+            coords[numCoords++] = nodes[leafPath[i - 1]].GetX();
+            coords[numCoords++] = nodes[leafPath[i - 1]].GetY();
+        }
+    }
+
+    return numWaypoints < numLeafs + 2 ? PATH_TRUNCATED : PATH_FOUND;
+}
+
+
+// Fills leafPath with the leafs between the two endpoint leafs in order,
+// returns their count or -1 without a path
+int AstarSearch::FindLeafPath(
+    const Quadtree& quadtree, const AstarGraph& graph,
+    int fromX, int fromY, int toX, int toY, const SearchOptions& options
+) {
+    numExpanded = 0;
+    bound = 1.0f;
+    leafPath.clear();
+
     int fromRegionIndex = quadtree.QueryValidRegion((uint32_t)fromX, (uint32_t)fromY);
     int toRegionIndex = quadtree.QueryValidRegion((uint32_t)toX, (uint32_t)toY);
 
 
     if (fromRegionIndex == -1 || toRegionIndex == -1) {
-        return path;
+        return -1;
+    }
+
+    // An overlay sized for another tree would mark the wrong leafs
+    if (overlay != nullptr && !overlay->IsCurrent(quadtree)) {
+        return -1;
+    }
+
+    agentRadius = clearance != nullptr ? std::max(0.0f, options.agentRadius) : 0.0f;
+
+    // The agent does not fit where it starts or ends
+    if (agentRadius > 0 && (clearance->GetLeafClearance(fromRegionIndex) < agentRadius
+            || clearance->GetLeafClearance(toRegionIndex) < agentRadius)) {
+        return -1;
     }
 
     // They are in the same region.
     if (fromRegionIndex == toRegionIndex) {
-        path.emplace_back(fromX);
-        path.emplace_back(fromY);
-        path.emplace_back(toX);
-        path.emplace_back(toY);
-        return path;
+        return 0;
     }
 
     const std::vector<AstarNode>& nodes = graph.GetNodes();
-    const std::vector<AstarEdge>& edges = graph.GetEdges();
+    const std::vector<int>& parents = parent[0];
 
-    std::vector<int> parent(nodes.size(), -1);
+    // Cached paths know nothing of the overlay or the agent radius
+    PathCache* const cache = overlay == nullptr && agentRadius == 0 ? pathCache : nullptr;
 
-    std::vector<float> gScores(nodes.size(), std::numeric_limits<float>::max());
+    if (cache != nullptr && cache->Lookup(quadtree, fromRegionIndex, toRegionIndex, leafPath)) {
+        return leafPath.size();
+    }
 
-    Heap<float> openSet = Heap<float>(
-        [](const float& a, const float& b) -> bool {
-            return a > b;
-        }
-    );
+    this->PrepareWorkspace(nodes.size());
 
-    ankerl::unordered_dense::set<int> closeSet;
+    const float weight = options.mode == SEARCH_OPTIMAL ? 1.0f : std::max(1.0f, options.weight);
 
-    openSet.Push(fromRegionIndex, fromRegionIndex);
+    bool isPathFound = false;
 
-    gScores[fromRegionIndex] = 0;
+    if (options.mode == SEARCH_FOCAL) {
+        isPathFound = this->SearchFocal(graph, fromRegionIndex, toRegionIndex, weight);
+    } else if (options.mode == SEARCH_OPTIMAL && options.openList == OPEN_LIST_RADIX_HEAP) {
+        isPathFound = this->SearchRadix(graph, fromRegionIndex, toRegionIndex, toX, toY);
+    } else {
+        isPathFound = this->SearchWeighted(graph, fromRegionIndex, toRegionIndex, toX, toY, weight);
+        bound = weight;
+    }
 
-    bool isPathFound = false;
+    if (!isPathFound) {
+        return -1;
+    }
+
+    // Counts the depth first so the leafs go in forward order
+    int depth = 0;
+    for (int node = toRegionIndex; node != -1; node = parents[node]) {
+        depth++;
+    }
+
+    leafPath.resize(depth);
+
+    int i = depth;
+    for (int node = toRegionIndex; node != -1; node = parents[node]) {
+        leafPath[--i] = node;
+    }
+
+    // Only optimal paths may be handed out again
+    if (cache != nullptr && options.mode == SEARCH_OPTIMAL) {
+        cache->Insert(quadtree, leafPath);
+    }
+
+    return depth;
+}
+
+
+// Best first search on gScore + weight * hScore, the path costs at most
+// weight times the optimum since the heuristic is consistent
+bool AstarSearch::SearchWeighted(const AstarGraph& graph, int fromRegionIndex, int toRegionIndex, int toX, int toY, float weight) {
+    const std::vector<AstarNode>& nodes = graph.GetNodes();
+    const std::vector<AstarEdge>& edges = graph.GetEdges();
+
+    std::vector<uint64_t>& gScores = labels[0];
+    std::vector<int>& parents = parent[0];
+    std::vector<unsigned int>& closeSet = closed[0];
+
+    openSet.Clear();
+
+    // Without arc flags every edge passes, they only hold for a point agent
+    // on the graph without an overlay
+    const uint64_t goalMask = arcFlags != nullptr && overlay == nullptr && agentRadius == 0 ? arcFlags->GetRegionMask(toRegionIndex) : ~(uint64_t)0;
+
+    openSet.Push(fromRegionIndex, fromRegionIndex);
+
+    gScores[fromRegionIndex] = PackLabel(stamp, 0);
+    parents[fromRegionIndex] = -1;
 
     while(openSet.GetSize() > 0) {
 
@@ -63,39 +252,56 @@ std::vector<int> AstarSearch::GetPath(const Quadtree& quadtree, const AstarGraph
         openSet.Pop();
 
         if (currentNodeIndex == toRegionIndex) {
-            isPathFound = true;
-            break;
+            return true;
         } 
 
-        closeSet.emplace(currentNodeIndex);
+        closeSet[currentNodeIndex] = stamp;
+
+        numExpanded++;
 
         // Expand neighbors
         const AstarNode& currentNode = nodes[currentNodeIndex];
 
         for (int i = currentNode.GetEdgeIndex(); i < currentNode.GetEdgeIndex() + currentNode.GetNumEdges(); ++i) {
+            if (arcFlags != nullptr && (arcFlags->GetFlags(i) & goalMask) == 0) {
+                continue;
+            }
+
+            if (agentRadius > 0 && clearance->GetEdgeClearance(i) < agentRadius) {
+                continue;
+            }
+
             const int nextNodeIndex = edges[i].GetNodeIdB();
-            const float nextNodeDist = edges[i].GetDist();
 
-            if (closeSet.find(nextNodeIndex) != closeSet.end()) {
+            if (overlay != nullptr && overlay->IsBlocked(nextNodeIndex)) {
+                continue;
+            }
+            const float nextNodeDist = edges[i].GetDist() + (overlay != nullptr ? overlay->GetCost(nextNodeIndex) : 0);
+
+            if (closeSet[nextNodeIndex] == stamp) {
                 continue;
             }
             
-            const float gScore = gScores[currentNodeIndex] + nextNodeDist;
+            const float gScore = UnpackScore(gScores[currentNodeIndex]) + nextNodeDist;
 
-            if (gScore < gScores[nextNodeIndex]) {
-                parent[nextNodeIndex] = currentNodeIndex;
-                gScores[nextNodeIndex] = gScore;
+            if (gScores[nextNodeIndex] >> 32 != stamp || gScore < UnpackScore(gScores[nextNodeIndex])) {
+                parents[nextNodeIndex] = currentNodeIndex;
+                gScores[nextNodeIndex] = PackLabel(stamp, gScore);
 
                 const int nextNodeX = nodes[nextNodeIndex].GetX();
                 const int nextNodeY = nodes[nextNodeIndex].GetY();
                 const float dX = nextNodeX - toX;
                 const float dY = nextNodeY - toY;
-                const float hScore = std::sqrt(dX * dX + dY * dY);
+                float hScore = std::sqrt(dX * dX + dY * dY);
+
+                if (landmarks != nullptr) {
+                    hScore = std::max(hScore, landmarks->Estimate(nextNodeIndex, toRegionIndex));
+                }
                 
-                const float fScore = gScore + hScore;
+                const float fScore = gScore + weight * hScore;
 
                 if (openSet.Push(fScore, nextNodeIndex)) {
-                    parent[nextNodeIndex] = currentNodeIndex;
+                    parents[nextNodeIndex] = currentNodeIndex;
                 }
             }
             
@@ -103,26 +309,405 @@ std::vector<int> AstarSearch::GetPath(const Quadtree& quadtree, const AstarGraph
 
     }
 
-    // Reconstruct path
-    if (isPathFound) {
-        path.emplace_back(toY);
-        path.emplace_back(toX);
+    return false;
+}
+
+
+// Same search as SearchWeighted at weight 1 on a radix heap. Keys are
+// rounded to fixed point, so ties closer than a key unit pop in any order.
+bool AstarSearch::SearchRadix(const AstarGraph& graph, int fromRegionIndex, int toRegionIndex, int toX, int toY) {
+    const std::vector<AstarNode>& nodes = graph.GetNodes();
+    const std::vector<AstarEdge>& edges = graph.GetEdges();
+
+    std::vector<uint64_t>& gScores = labels[0];
+    std::vector<int>& parents = parent[0];
+    std::vector<unsigned int>& closeSet = closed[0];
+
+    const uint64_t goalMask = arcFlags != nullptr && overlay == nullptr && agentRadius == 0 ? arcFlags->GetRegionMask(toRegionIndex) : ~(uint64_t)0;
+
+    radixHeap.Clear();
+    radixHeap.Push(0, fromRegionIndex);
+
+    gScores[fromRegionIndex] = PackLabel(stamp, 0);
+    parents[fromRegionIndex] = -1;
+
+    while (radixHeap.GetSize() > 0) {
+        const int currentNodeIndex = radixHeap.TopItemID();
+
+        radixHeap.Pop();
+
+        // Stale copy of a node pushed again with a better gScore
+        if (closeSet[currentNodeIndex] == stamp) {
+            continue;
+        }
+
+        if (currentNodeIndex == toRegionIndex) {
+            return true;
+        }
+
+        closeSet[currentNodeIndex] = stamp;
+
+        numExpanded++;
+
+        const AstarNode& currentNode = nodes[currentNodeIndex];
+
+        for (int i = currentNode.GetEdgeIndex(); i < currentNode.GetEdgeIndex() + currentNode.GetNumEdges(); ++i) {
+            if (arcFlags != nullptr && (arcFlags->GetFlags(i) & goalMask) == 0) {
+                continue;
+            }
+
+            if (agentRadius > 0 && clearance->GetEdgeClearance(i) < agentRadius) {
+                continue;
+            }
+
+            const int nextNodeIndex = edges[i].GetNodeIdB();
+
+            if (overlay != nullptr && overlay->IsBlocked(nextNodeIndex)) {
+                continue;
+            }
+
+            if (closeSet[nextNodeIndex] == stamp) {
+                continue;
+            }
+
+            const float gScore = UnpackScore(gScores[currentNodeIndex]) + edges[i].GetDist() + (overlay != nullptr ? overlay->GetCost(nextNodeIndex) : 0);
+
+            if (gScores[nextNodeIndex] >> 32 != stamp || gScore < UnpackScore(gScores[nextNodeIndex])) {
+                parents[nextNodeIndex] = currentNodeIndex;
+                gScores[nextNodeIndex] = PackLabel(stamp, gScore);
+
+                const float dX = nodes[nextNodeIndex].GetX() - toX;
+                const float dY = nodes[nextNodeIndex].GetY() - toY;
+                float hScore = std::sqrt(dX * dX + dY * dY);
+
+                if (landmarks != nullptr) {
+                    hScore = std::max(hScore, landmarks->Estimate(nextNodeIndex, toRegionIndex));
+                }
+
+                radixHeap.Push(ToFixedPoint(gScore + hScore), nextNodeIndex);
+            }
+        }
+    }
+
+    return false;
+}
+
+
+// Expands the open node with the smallest gScore + weight * hScore among
+// those whose fScore is within weight of the smallest fScore. Improved
+// nodes are reopened so the smallest fScore stays a lower bound on the
+// optimum, which the achieved bound is measured against.
+bool AstarSearch::SearchFocal(const AstarGraph& graph, int fromRegionIndex, int toRegionIndex, float weight) {
+    const std::vector<AstarNode>& nodes = graph.GetNodes();
+    const std::vector<AstarEdge>& edges = graph.GetEdges();
+
+    std::vector<uint64_t>& gScores = labels[0];
+    std::vector<int>& parents = parent[0];
+    std::vector<unsigned int>& closeSet = closed[0];
+
+    // Open nodes by fScore, and the focal subset by weighted fScore
+    std::set<std::pair<float, int>> openSet;
+    std::set<std::pair<float, int>> focalSet;
 
-        int currentNodeIndex = toRegionIndex;
+    const uint64_t goalMask = arcFlags != nullptr && overlay == nullptr && agentRadius == 0 ? arcFlags->GetRegionMask(toRegionIndex) : ~(uint64_t)0;
 
-        do {
-            const int y = nodes[currentNodeIndex].GetY();
-            const int x = nodes[currentNodeIndex].GetX();
-            path.emplace_back(y);
-            path.emplace_back(x);
-            currentNodeIndex = parent[currentNodeIndex];
-        } while (currentNodeIndex != -1);
+    const float fromHScore = this->Estimate(graph, fromRegionIndex, toRegionIndex);
 
+    gScores[fromRegionIndex] = PackLabel(stamp, 0);
+    parents[fromRegionIndex] = -1;
+    openSet.emplace(fromHScore, fromRegionIndex);
+    focalSet.emplace(weight * fromHScore, fromRegionIndex);
+
+    float minFScore = fromHScore;
+
+    while (openSet.size() > 0) {
+
+        // Admit the nodes a larger minimum brings into range
+        const float nextMinFScore = openSet.begin()->first;
+
+        if (nextMinFScore > minFScore) {
+            auto it = openSet.upper_bound(std::make_pair(weight * minFScore, std::numeric_limits<int>::max()));
+
+            for (; it != openSet.end() && it->first <= weight * nextMinFScore; ++it) {
+                focalSet.emplace(UnpackScore(gScores[it->second]) + weight * this->Estimate(graph, it->second, toRegionIndex), it->second);
+            }
+
+            minFScore = nextMinFScore;
+        }
+
+        const int currentNodeIndex = focalSet.begin()->second;
+        const float currentGScore = UnpackScore(gScores[currentNodeIndex]);
+        const float currentHScore = this->Estimate(graph, currentNodeIndex, toRegionIndex);
+
+        focalSet.erase(focalSet.begin());
+        openSet.erase(std::make_pair(currentGScore + currentHScore, currentNodeIndex));
+
+        if (currentNodeIndex == toRegionIndex) {
+            bound = minFScore > 0 ? std::max(1.0f, currentGScore / minFScore) : 1.0f;
+            return true;
+        }
+
+        closeSet[currentNodeIndex] = stamp;
+
+        numExpanded++;
+
+        const AstarNode& currentNode = nodes[currentNodeIndex];
+
+        for (int i = currentNode.GetEdgeIndex(); i < currentNode.GetEdgeIndex() + currentNode.GetNumEdges(); ++i) {
+            if (arcFlags != nullptr && (arcFlags->GetFlags(i) & goalMask) == 0) {
+                continue;
+            }
+
+            if (agentRadius > 0 && clearance->GetEdgeClearance(i) < agentRadius) {
+                continue;
+            }
+
+            const int nextNodeIndex = edges[i].GetNodeIdB();
+
+            if (overlay != nullptr && overlay->IsBlocked(nextNodeIndex)) {
+                continue;
+            }
+            const float gScore = currentGScore + edges[i].GetDist() + (overlay != nullptr ? overlay->GetCost(nextNodeIndex) : 0);
+
+            const bool isLabelled = gScores[nextNodeIndex] >> 32 == stamp;
+
+            if (isLabelled && gScore >= UnpackScore(gScores[nextNodeIndex])) {
+                continue;
+            }
+
+            const float hScore = this->Estimate(graph, nextNodeIndex, toRegionIndex);
+
+            if (isLabelled && closeSet[nextNodeIndex] != stamp) {
+                openSet.erase(std::make_pair(UnpackScore(gScores[nextNodeIndex]) + hScore, nextNodeIndex));
+                focalSet.erase(std::make_pair(UnpackScore(gScores[nextNodeIndex]) + weight * hScore, nextNodeIndex));
+            }
+
+            // Reopens closed nodes too
+            closeSet[nextNodeIndex] = 0;
+            gScores[nextNodeIndex] = PackLabel(stamp, gScore);
+            parents[nextNodeIndex] = currentNodeIndex;
+
+            openSet.emplace(gScore + hScore, nextNodeIndex);
+
+            if (gScore + hScore <= weight * minFScore) {
+                focalSet.emplace(gScore + weight * hScore, nextNodeIndex);
+            }
+        }
+    }
+
+    return false;
+}
+
+
+float AstarSearch::Estimate(const AstarGraph& graph, int node, int target) const {
+    const std::vector<AstarNode>& nodes = graph.GetNodes();
+
+    const float dX = nodes[node].GetX() - nodes[target].GetX();
+    const float dY = nodes[node].GetY() - nodes[target].GetY();
+    const float estimate = std::sqrt(dX * dX + dY * dY);
+
+    if (landmarks != nullptr) {
+        return std::max(estimate, landmarks->Estimate(node, target));
+    }
+
+    return estimate;
+}
+
+
+// Returns a list of x y coords
+std::vector<int> AstarSearch::GetPathBidirectional(
+    const Quadtree& quadtree, const AstarGraph& graph,
+    int fromX, int fromY, int toX, int toY, bool isThreaded,
+    float agentRadius
+) {
+    std::vector<int> path; // xyxyxy...
+
+    numExpanded = 0;
+
+    int fromRegionIndex = quadtree.QueryValidRegion((uint32_t)fromX, (uint32_t)fromY);
+    int toRegionIndex = quadtree.QueryValidRegion((uint32_t)toX, (uint32_t)toY);
+
+    if (fromRegionIndex == -1 || toRegionIndex == -1) {
+        return path;
+    }
+
+    if (overlay != nullptr && !overlay->IsCurrent(quadtree)) {
+        return path;
+    }
+
+    this->agentRadius = clearance != nullptr ? std::max(0.0f, agentRadius) : 0.0f;
+
+    // The agent does not fit where it starts or ends
+    if (this->agentRadius > 0 && (clearance->GetLeafClearance(fromRegionIndex) < this->agentRadius
+            || clearance->GetLeafClearance(toRegionIndex) < this->agentRadius)) {
+        return path;
+    }
+
+    // The start leaf is always left but a blocked goal is never entered
+    if (overlay != nullptr && fromRegionIndex != toRegionIndex && overlay->IsBlocked(toRegionIndex)) {
+        return path;
+    }
+
+    // They are in the same region.
+    if (fromRegionIndex == toRegionIndex) {
+        path.emplace_back(fromX);
         path.emplace_back(fromY);
+        path.emplace_back(toX);
+        path.emplace_back(toY);
+        return path;
+    }
+
+    const std::vector<AstarNode>& nodes = graph.GetNodes();
+    const std::vector<AstarEdge>& edges = graph.GetEdges();
+
+    this->PrepareWorkspace(nodes.size());
+
+    const int ends[2] = {fromRegionIndex, toRegionIndex};
+
+    Heap<float> openSets[2] = {
+        Heap<float>([](const float& a, const float& b) -> bool { return a > b; }),
+        Heap<float>([](const float& a, const float& b) -> bool { return a > b; })
+    };
+
+    // Smallest key left in each direction, read by the other thread
+    std::atomic<float> topKeys[2];
+
+    std::atomic<uint64_t> meeting(PackMeeting(std::numeric_limits<float>::max(), -1));
+
+    int expanded[2] = {0, 0};
+
+    // Both ends are labelled before any thread starts so neither can miss the other
+    for (int dir = 0; dir < 2; ++dir) {
+        __atomic_store_n(&labels[dir][ends[dir]], PackLabel(stamp, 0), __ATOMIC_SEQ_CST);
+        parent[dir][ends[dir]] = -1;
+
+        // Average potential, p(v) = (h(v, to) - h(v, from)) / 2 forward and -p(v) backward
+        const float potential = (this->Estimate(graph, ends[dir], toRegionIndex) - this->Estimate(graph, ends[dir], fromRegionIndex)) / 2;
+        openSets[dir].Push(dir == 0 ? potential : -potential, ends[dir]);
+        topKeys[dir] = openSets[dir].TopItem();
+    }
+
+    auto updateMeeting = [&](float cost, int node) {
+        const uint64_t candidate = PackMeeting(cost, node);
+        uint64_t current = meeting.load();
+
+        while (candidate < current && !meeting.compare_exchange_weak(current, candidate)) {}
+    };
+
+    // With consistent potentials the key sum of the two frontiers bounds every
+    // path not found yet
+    auto isDone = [&](int dir) -> bool {
+        const float bestCost = UnpackScore(meeting.load() >> 32);
+        return topKeys[dir].load() + topKeys[dir ^ 1].load() >= bestCost;
+    };
+
+    auto expand = [&](int dir) {
+        Heap<float>& openSet = openSets[dir];
+
+        const int currentNodeIndex = openSet.TopItemID();
+        openSet.Pop();
+
+        closed[dir][currentNodeIndex] = stamp;
+        expanded[dir]++;
+
+        const float currentScore = UnpackScore(labels[dir][currentNodeIndex]);
+        const AstarNode& currentNode = nodes[currentNodeIndex];
+
+        // Backward the edge runs from next to current, so entering current is paid
+        const float enterCost = overlay == nullptr ? 0 : overlay->GetCost(currentNodeIndex);
+
+        for (int i = currentNode.GetEdgeIndex(); i < currentNode.GetEdgeIndex() + currentNode.GetNumEdges(); ++i) {
+            if (this->agentRadius > 0 && clearance->GetEdgeClearance(i) < this->agentRadius) {
+                continue;
+            }
+
+            const int nextNodeIndex = edges[i].GetNodeIdB();
+
+            if (closed[dir][nextNodeIndex] == stamp) {
+                continue;
+            }
+
+            if (overlay != nullptr && overlay->IsBlocked(nextNodeIndex) && nextNodeIndex != fromRegionIndex) {
+                continue;
+            }
+
+            const float gScore = currentScore + edges[i].GetDist() + (overlay == nullptr ? 0
+                : dir == 0 ? overlay->GetCost(nextNodeIndex) : enterCost);
+            const uint64_t label = labels[dir][nextNodeIndex];
+
+            if (label >> 32 == stamp && UnpackScore(label) <= gScore) {
+                continue;
+            }
+
+            __atomic_store_n(&labels[dir][nextNodeIndex], PackLabel(stamp, gScore), __ATOMIC_SEQ_CST);
+            parent[dir][nextNodeIndex] = currentNodeIndex;
+
+            const uint64_t otherLabel = __atomic_load_n(&labels[dir ^ 1][nextNodeIndex], __ATOMIC_SEQ_CST);
+
+            if (otherLabel >> 32 == stamp) {
+                updateMeeting(gScore + UnpackScore(otherLabel), nextNodeIndex);
+            }
+
+            const float potential = (this->Estimate(graph, nextNodeIndex, toRegionIndex) - this->Estimate(graph, nextNodeIndex, fromRegionIndex)) / 2;
+            openSet.Push(gScore + (dir == 0 ? potential : -potential), nextNodeIndex);
+        }
+
+        topKeys[dir] = openSet.GetSize() > 0 ? openSet.TopItem() : std::numeric_limits<float>::max();
+    };
+
+#ifdef PLATFORM_WEB
+    isThreaded = false;
+#endif
+
+    if (isThreaded) {
+        auto run = [&](int dir) {
+            while (openSets[dir].GetSize() > 0 && !isDone(dir)) {
+                expand(dir);
+            }
+            topKeys[dir] = std::numeric_limits<float>::max();
+        };
+
+        std::thread backward(run, 1);
+        run(0);
+        backward.join();
+    } else {
+        // Expand the smaller frontier
+        while (!isDone(0)) {
+            const int dir = openSets[0].GetSize() <= openSets[1].GetSize() ? 0 : 1;
+
+            if (openSets[dir].GetSize() == 0) break;
+
+            expand(dir);
+        }
+    }
+
+    numExpanded = expanded[0] + expanded[1];
+
+    const int meetingNode = (uint32_t)meeting.load();
+
+    // Reconstruct path
+    if (meetingNode != -1) {
         path.emplace_back(fromX);
+        path.emplace_back(fromY);
+
+        std::vector<int> forwardNodes;
+        for (int node = meetingNode; node != -1; node = parent[0][node]) {
+            forwardNodes.emplace_back(node);
+        }
+
+        for (int i = forwardNodes.size() - 1; i >= 0; --i) {
+            path.emplace_back(nodes[forwardNodes[i]].GetX());
+            path.emplace_back(nodes[forwardNodes[i]].GetY());
+        }
 
-        std::reverse(path.begin(), path.end());
+        for (int node = parent[1][meetingNode]; node != -1; node = parent[1][node]) {
+            path.emplace_back(nodes[node].GetX());
+            path.emplace_back(nodes[node].GetY());
+        }
+
+        path.emplace_back(toX);
+        path.emplace_back(toY);
     }
 
     return path;
-};
\ No newline at end of file
+}
@@ -0,0 +1,128 @@
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+#include "BatchSearch.hpp"
+#include "Parallel.hpp"
+
+
+BatchSearch::BatchSearch() {
+    this->SetNumThreads(Parallel::GetNumThreads());
+}
+
+
+void BatchSearch::SetNumThreads(int numThreads) {
+    this->numThreads = std::max(1, numThreads);
+    searches.resize(this->numThreads);
+    buffers.resize(this->numThreads);
+}
+
+
+void BatchSearch::Run(
+    const Quadtree& quadtree, const AstarGraph& graph,
+    const PathRequest* requests, int numRequests,
+    PathArena& arena, PathResult* results
+) {
+    const std::vector<Quadrant>& leafs = quadtree.GetLeafs();
+
+    for (AstarSearch& search : searches) {
+        search.SetLandmarks(landmarks);
+        search.SetArcFlags(arcFlags);
+    }
+
+    // Sort key is the source leaf code, ties broken by the target leaf
+    pairs.resize(numRequests);
+    order.resize(numRequests);
+
+    Parallel::For(numRequests, [&](int i) {
+        const PathRequest& request = requests[i];
+        const int from = quadtree.QueryValidRegion((uint32_t)request.fromX, (uint32_t)request.fromY);
+        const int to = quadtree.QueryValidRegion((uint32_t)request.toX, (uint32_t)request.toY);
+
+        if (from == -1 || to == -1) {
+            pairs[i] = UINT64_MAX;
+        } else {
+            pairs[i] = (uint64_t)from << 32 | (uint32_t)to;
+        }
+    });
+
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](int a, int b) {
+        if (pairs[a] == pairs[b] || pairs[a] == UINT64_MAX || pairs[b] == UINT64_MAX) {
+            return pairs[a] < pairs[b];
+        }
+
+        const uint64_t codeA = leafs[pairs[a] >> 32].GetCode();
+        const uint64_t codeB = leafs[pairs[b] >> 32].GetCode();
+
+        if (codeA != codeB) return codeA < codeB;
+
+        return pairs[a] < pairs[b];
+    });
+
+    // Unresolved requests sort last and get no group
+    int numResolved = 0;
+    groupBegin.clear();
+
+    for (int i = 0; i < numRequests; ++i) {
+        if (pairs[order[i]] == UINT64_MAX) {
+            results[order[i]] = PathResult{0, 0};
+            continue;
+        }
+
+        if (groupBegin.size() == 0 || pairs[order[i]] != pairs[order[groupBegin.back()]]) {
+            groupBegin.push_back(i);
+        }
+
+        numResolved++;
+    }
+
+    numSearches = groupBegin.size();
+    groupBegin.push_back(numResolved);
+
+    Parallel::ForStealing(numSearches, numThreads, [&](int group, int thread) {
+        const int first = order[groupBegin[group]];
+        const PathRequest& request = requests[first];
+
+        // The size of a path is only known once it is found, so it goes to
+        // the worker's buffer first. The buffer grows until the path fits and
+        // is kept between runs, a batch does not allocate per query.
+        std::vector<int>& path = buffers[thread];
+        int numCoords;
+        PathStatus status;
+
+        while ((status = searches[thread].GetPath(
+                quadtree, graph, request.fromX, request.fromY, request.toX, request.toY,
+                path.data(), path.size(), numCoords)) == PATH_TRUNCATED) {
+            path.resize(std::max<size_t>(64, 2 * path.size()));
+        }
+
+        // Every request of the group shares the leaf centres, only the end points differ
+        for (int i = groupBegin[group]; i < groupBegin[group + 1]; ++i) {
+            const int index = order[i];
+
+            if (status == PATH_NOT_FOUND) {
+                results[index] = PathResult{0, 0};
+                continue;
+            }
+
+            const int offset = arena.Allocate(numCoords);
+
+            if (offset == -1) {
+                results[index] = PathResult{-1, 0};
+                continue;
+            }
+
+            int* coords = arena.GetCoords(offset);
+            std::copy(path.begin(), path.begin() + numCoords, coords);
+
+            coords[0] = requests[index].fromX;
+            coords[1] = requests[index].fromY;
+            coords[numCoords - 2] = requests[index].toX;
+            coords[numCoords - 1] = requests[index].toY;
+
+            results[index] = PathResult{offset, numCoords};
+        }
+    });
+}
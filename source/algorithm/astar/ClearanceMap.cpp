@@ -0,0 +1,191 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "AstarGraph.hpp"
+#include "ClearanceMap.hpp"
+#include "GridEnvironment.hpp"
+#include "Parallel.hpp"
+#include "Quadtree.hpp"
+
+
+namespace {
+    constexpr double FAR = 1e20;
+
+    struct Scratch {
+        std::vector<double> input;
+        std::vector<double> output;
+        std::vector<int> parabolas;
+        std::vector<double> bounds;
+
+        void Resize(int n) {
+            input.resize(n);
+            output.resize(n);
+            parabolas.resize(n);
+            bounds.resize(n + 1);
+        }
+    };
+
+    // Squared distance transform of one line after Felzenszwalb and
+    // Huttenlocher, the lower envelope of the parabolas rooted at every sample
+    void TransformLine(Scratch& scratch, int n) {
+        const std::vector<double>& f = scratch.input;
+        std::vector<int>& v = scratch.parabolas;
+        std::vector<double>& z = scratch.bounds;
+
+        int k = 0;
+        v[0] = 0;
+        z[0] = -FAR;
+        z[1] = FAR;
+
+        for (int q = 1; q < n; ++q) {
+            double s;
+
+            while (true) {
+                s = ((f[q] + (double)q * q) - (f[v[k]] + (double)v[k] * v[k])) / (2.0 * q - 2.0 * v[k]);
+
+                if (s > z[k] || k == 0) break;
+                k--;
+            }
+
+            k++;
+            v[k] = q;
+            z[k] = s;
+            z[k + 1] = FAR;
+        }
+
+        k = 0;
+        for (int q = 0; q < n; ++q) {
+            while (z[k + 1] < q) {
+                k++;
+            }
+
+            const double dq = q - v[k];
+            scratch.output[q] = dq * dq + f[v[k]];
+        }
+    }
+}
+
+
+void ClearanceMap::Build(const GridEnvironment& grid, const Quadtree& quadtree, const AstarGraph& graph) {
+    const int width = grid.GetWidth();
+    const int height = grid.GetHeight();
+
+    // One blocked cell of padding on every side
+    const int paddedWidth = width + 2;
+    const int paddedHeight = height + 2;
+
+    std::vector<float> squared((size_t)paddedWidth * paddedHeight);
+
+    const int numThreads = Parallel::GetNumThreads();
+    std::vector<Scratch> scratches(numThreads);
+    for (Scratch& scratch : scratches) {
+        scratch.Resize(std::max(paddedWidth, paddedHeight));
+    }
+
+    // Columns first, the padding leaves a blocked cell at both ends of each
+    Parallel::ForStealing(paddedWidth, numThreads, [&](int x, int thread) {
+        Scratch& scratch = scratches[thread];
+
+        for (int y = 0; y < paddedHeight; ++y) {
+            const bool isInside = x > 0 && y > 0 && x <= width && y <= height;
+            scratch.input[y] = isInside && grid.IsValid((size_t)(y - 1) * width + x - 1) ? FAR : 0;
+        }
+
+        TransformLine(scratch, paddedHeight);
+
+        for (int y = 0; y < paddedHeight; ++y) {
+            squared[(size_t)y * paddedWidth + x] = scratch.output[y];
+        }
+    });
+
+    Parallel::ForStealing(paddedHeight, numThreads, [&](int y, int thread) {
+        Scratch& scratch = scratches[thread];
+        float* row = squared.data() + (size_t)y * paddedWidth;
+
+        std::copy(row, row + paddedWidth, scratch.input.begin());
+
+        TransformLine(scratch, paddedWidth);
+
+        for (int x = 0; x < paddedWidth; ++x) {
+            row[x] = scratch.output[x];
+        }
+    });
+
+    auto distanceAt = [&](int x, int y) -> float {
+        if (x < 0 || y < 0 || x >= width || y >= height) return 0;
+
+        return std::sqrt(squared[(size_t)(y + 1) * paddedWidth + x + 1]);
+    };
+
+    const std::vector<Quadrant>& leafs = quadtree.GetLeafs();
+    const std::vector<AstarNode>& nodes = graph.GetNodes();
+    const std::vector<AstarEdge>& edges = graph.GetEdges();
+    const int resolution = quadtree.GetResolution();
+
+    leafClearances.assign(nodes.size(), 0);
+    edgeClearances.assign(edges.size(), 0);
+
+    Parallel::For(nodes.size(), [&](int node) {
+        const Quadrant& quad = leafs[node];
+
+        if (!quad.IsValid()) return;
+
+        const int x = quad.GetX();
+        const int y = quad.GetY();
+        const int length = 1 << (resolution - quad.GetLevel());
+
+        float best = 0;
+        for (int cellY = y; cellY < std::min(y + length, height); ++cellY) {
+            for (int cellX = x; cellX < std::min(x + length, width); ++cellX) {
+                best = std::max(best, distanceAt(cellX, cellY));
+            }
+        }
+        leafClearances[node] = best;
+
+        // Pairs of cells facing each other across the shared side
+        for (int i = nodes[node].GetEdgeIndex(); i < nodes[node].GetEdgeIndex() + nodes[node].GetNumEdges(); ++i) {
+            const Quadrant& other = leafs[edges[i].GetNodeIdB()];
+            const int otherX = other.GetX();
+            const int otherY = other.GetY();
+            const int otherLength = 1 << (resolution - other.GetLevel());
+
+            int cellX, cellY, stepX, stepY, facingX, facingY, count;
+
+            if (otherX == x + length || otherX + otherLength == x) {
+                cellX = otherX == x + length ? x + length - 1 : x;
+                facingX = otherX == x + length ? otherX : x - 1;
+                cellY = std::max(y, otherY);
+                facingY = 0;
+                stepX = 0;
+                stepY = 1;
+                count = std::min(y + length, otherY + otherLength) - cellY;
+            } else {
+                cellY = otherY == y + length ? y + length - 1 : y;
+                facingY = otherY == y + length ? otherY : y - 1;
+                cellX = std::max(x, otherX);
+                facingX = 0;
+                stepX = 1;
+                stepY = 0;
+                count = std::min(x + length, otherX + otherLength) - cellX;
+            }
+
+            float clearance = 0;
+            for (int k = 0; k < count; ++k) {
+                const int aX = cellX + k * stepX;
+                const int aY = cellY + k * stepY;
+                const int bX = stepX == 0 ? facingX : aX;
+                const int bY = stepY == 0 ? facingY : aY;
+
+                clearance = std::max(clearance, std::min(distanceAt(aX, aY), distanceAt(bX, bY)));
+            }
+            edgeClearances[i] = clearance;
+        }
+    });
+}
+
+
+void ClearanceMap::Clear() {
+    leafClearances.clear();
+    edgeClearances.clear();
+}
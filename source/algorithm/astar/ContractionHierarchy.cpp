@@ -0,0 +1,641 @@
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "ankerl/unordered_dense.h"
+
+#include "AstarGraph.hpp"
+#include "ContractionHierarchy.hpp"
+#include "Parallel.hpp"
+#include "Quadtree.hpp"
+
+
+namespace {
+    // Settled node limit of a witness search, a missed witness only costs an extra shortcut
+    constexpr int WITNESS_LIMIT = 500;
+    constexpr float EPSILON = 1e-4f;
+
+    struct QueueEntry {
+        float key;
+        int node;
+
+        bool operator>(const QueueEntry& other) const {
+            return key > other.key;
+        }
+    };
+
+    using MinQueue = std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>>;
+
+    struct Shortcut {
+        int from;
+        int to;
+        float dist;
+        int middle;
+    };
+
+    using Adjacency = std::vector<std::vector<ContractionEdge>>;
+
+    void AddOrImprove(std::vector<ContractionEdge>& edges, int target, float dist, int middle) {
+        for (ContractionEdge& edge : edges) {
+            if (edge.GetTarget() != target) continue;
+            if (dist < edge.GetDist()) edge.Improve(dist, middle);
+            return;
+        }
+        edges.emplace_back(target, dist, middle);
+    }
+
+    // Shortcuts needed to contract node, witness paths may not pass through
+    // node itself or any node flagged in skip
+    void FindShortcuts(
+        const Adjacency& adjacency,
+        const std::vector<char>& skip,
+        int node,
+        ankerl::unordered_dense::map<int, float>& distances,
+        std::vector<Shortcut>& shortcuts
+    ) {
+        const std::vector<ContractionEdge>& neighbors = adjacency[node];
+
+        for (int i = 0; i < neighbors.size(); ++i) {
+            const int from = neighbors[i].GetTarget();
+
+            float maxDist = 0;
+            for (int j = i + 1; j < neighbors.size(); ++j) {
+                maxDist = std::max(maxDist, neighbors[i].GetDist() + neighbors[j].GetDist());
+            }
+
+            if (i + 1 == neighbors.size()) break;
+
+            distances.clear();
+            distances.emplace(from, 0);
+
+            MinQueue queue;
+            queue.push(QueueEntry{0, from});
+
+            int settled = 0;
+
+            while (queue.size() > 0 && settled < WITNESS_LIMIT) {
+                const QueueEntry current = queue.top();
+                queue.pop();
+
+                if (current.key > distances[current.node]) continue;
+                if (current.key > maxDist) break;
+
+                settled++;
+
+                for (const ContractionEdge& edge : adjacency[current.node]) {
+                    const int next = edge.GetTarget();
+                    if (next == node || skip[next]) continue;
+
+                    const float dist = current.key + edge.GetDist();
+                    auto iterator = distances.find(next);
+
+                    if (iterator == distances.end() || dist < iterator->second) {
+                        distances.insert_or_assign(next, dist);
+                        queue.push(QueueEntry{dist, next});
+                    }
+                }
+            }
+
+            for (int j = i + 1; j < neighbors.size(); ++j) {
+                const int to = neighbors[j].GetTarget();
+                const float viaDist = neighbors[i].GetDist() + neighbors[j].GetDist();
+
+                auto iterator = distances.find(to);
+                if (iterator != distances.end() && iterator->second <= viaDist + EPSILON) continue;
+
+                shortcuts.push_back(Shortcut{from, to, viaDist, node});
+            }
+        }
+    }
+}
+
+
+void ContractionHierarchy::Build(const AstarGraph& graph) {
+    this->Clear();
+
+    const std::vector<AstarNode>& nodes = graph.GetNodes();
+    const std::vector<AstarEdge>& edges = graph.GetEdges();
+    const int numNodes = nodes.size();
+
+    // Remaining graph, only holds edges between uncontracted nodes
+    Adjacency adjacency(numNodes);
+
+    for (int i = 0; i < numNodes; ++i) {
+        for (int e = nodes[i].GetEdgeIndex(); e < nodes[i].GetEdgeIndex() + nodes[i].GetNumEdges(); ++e) {
+            if (edges[e].GetNodeIdB() == i) continue;
+            AddOrImprove(adjacency[i], edges[e].GetNodeIdB(), edges[e].GetDist(), -1);
+            AddOrImprove(adjacency[edges[e].GetNodeIdB()], i, edges[e].GetDist(), -1);
+        }
+    }
+
+    rank.assign(numNodes, -1);
+
+    std::vector<float> priority(numNodes, 0);
+    std::vector<int> deletedNeighbors(numNodes, 0);
+    std::vector<char> inSet(numNodes, 0);
+    std::vector<char> noSkip(numNodes, 0);
+    Adjacency upward(numNodes);
+
+    auto computePriority = [&](int node, ankerl::unordered_dense::map<int, float>& distances, std::vector<Shortcut>& shortcuts) {
+        shortcuts.clear();
+        FindShortcuts(adjacency, noSkip, node, distances, shortcuts);
+        priority[node] = (float)shortcuts.size() - adjacency[node].size() + deletedNeighbors[node];
+    };
+
+    std::vector<int> remaining(numNodes);
+    for (int i = 0; i < numNodes; ++i) {
+        remaining[i] = i;
+    }
+
+    const int numThreads = Parallel::GetNumThreads();
+
+    auto forEachChunk = [&](const std::vector<int>& work, const std::function<void(int, ankerl::unordered_dense::map<int, float>&, std::vector<Shortcut>&)>& function) {
+        const int chunkSize = std::max(1, (int)(work.size() + numThreads * 4 - 1) / (numThreads * 4));
+        const int numChunks = (work.size() + chunkSize - 1) / chunkSize;
+
+        Parallel::For(numChunks, [&](int chunk) {
+            ankerl::unordered_dense::map<int, float> distances;
+            std::vector<Shortcut> shortcuts;
+            for (int i = chunk * chunkSize; i < std::min((int)work.size(), (chunk + 1) * chunkSize); ++i) {
+                function(work[i], distances, shortcuts);
+            }
+        });
+    };
+
+    forEachChunk(remaining, computePriority);
+
+    int nextRank = 0;
+    std::vector<int> independentSet;
+    std::vector<std::vector<Shortcut>> setShortcuts;
+    std::vector<int> updated;
+
+    while (remaining.size() > 0) {
+        // Nodes that come before all of their neighbours, ties broken by index
+        independentSet.clear();
+
+        for (int node : remaining) {
+            bool isMinimal = true;
+
+            for (const ContractionEdge& edge : adjacency[node]) {
+                const int other = edge.GetTarget();
+                if (std::tie(priority[other], other) < std::tie(priority[node], node)) {
+                    isMinimal = false;
+                    break;
+                }
+            }
+
+            if (isMinimal) independentSet.push_back(node);
+        }
+
+        for (int node : independentSet) {
+            inSet[node] = 1;
+        }
+
+        // Witness searches skip the whole set, so a witness never runs
+        // through a node contracted in the same round
+        setShortcuts.resize(independentSet.size());
+
+        Parallel::For(independentSet.size(), [&](int i) {
+            ankerl::unordered_dense::map<int, float> distances;
+            setShortcuts[i].clear();
+            FindShortcuts(adjacency, inSet, independentSet[i], distances, setShortcuts[i]);
+        });
+
+        updated.clear();
+
+        for (int node : independentSet) {
+            rank[node] = nextRank++;
+            upward[node] = adjacency[node];
+
+            for (const ContractionEdge& edge : adjacency[node]) {
+                std::vector<ContractionEdge>& neighborEdges = adjacency[edge.GetTarget()];
+
+                neighborEdges.erase(std::remove_if(neighborEdges.begin(), neighborEdges.end(),
+                    [node](const ContractionEdge& other) -> bool {
+                        return other.GetTarget() == node;
+                    }
+                ), neighborEdges.end());
+
+                deletedNeighbors[edge.GetTarget()]++;
+                updated.push_back(edge.GetTarget());
+            }
+        }
+
+        for (int node : independentSet) {
+            adjacency[node].clear();
+            adjacency[node].shrink_to_fit();
+            inSet[node] = 0;
+        }
+
+        for (const std::vector<Shortcut>& shortcuts : setShortcuts) {
+            for (const Shortcut& shortcut : shortcuts) {
+                AddOrImprove(adjacency[shortcut.from], shortcut.to, shortcut.dist, shortcut.middle);
+                AddOrImprove(adjacency[shortcut.to], shortcut.from, shortcut.dist, shortcut.middle);
+            }
+        }
+
+        remaining.erase(std::remove_if(remaining.begin(), remaining.end(),
+            [this](int node) -> bool {
+                return rank[node] != -1;
+            }
+        ), remaining.end());
+
+        std::sort(updated.begin(), updated.end());
+        updated.erase(std::unique(updated.begin(), updated.end()), updated.end());
+
+        forEachChunk(updated, computePriority);
+    }
+
+    edgeIndex.resize(numNodes + 1);
+    edgeIndex[0] = 0;
+
+    for (int i = 0; i < numNodes; ++i) {
+        edgeIndex[i + 1] = edgeIndex[i] + upward[i].size();
+        upwardEdges.insert(upwardEdges.end(), upward[i].begin(), upward[i].end());
+    }
+}
+
+
+const ContractionEdge* ContractionHierarchy::FindUpwardEdge(int from, int to) const {
+    const int lower = rank[from] < rank[to] ? from : to;
+    const int upper = lower == from ? to : from;
+
+    const ContractionEdge* result = nullptr;
+
+    for (int i = edgeIndex[lower]; i < edgeIndex[lower + 1]; ++i) {
+        if (upwardEdges[i].GetTarget() == upper && (result == nullptr || upwardEdges[i].GetDist() < result->GetDist())) {
+            result = &upwardEdges[i];
+        }
+    }
+
+    return result;
+}
+
+
+void ContractionHierarchy::Unpack(int from, const ContractionEdge& edge, std::vector<int>& nodes) const {
+    // Stack of (from, to, middle), unpacked left to right
+    std::vector<std::tuple<int, int, int>> stack;
+    stack.emplace_back(from, edge.GetTarget(), edge.GetMiddle());
+
+    while (stack.size() > 0) {
+        const auto [a, b, middle] = stack.back();
+        stack.pop_back();
+
+        if (middle == -1) {
+            nodes.push_back(b);
+            continue;
+        }
+
+        const ContractionEdge* second = this->FindUpwardEdge(middle, b);
+        const ContractionEdge* first = this->FindUpwardEdge(a, middle);
+
+        stack.emplace_back(middle, b, second->GetMiddle());
+        stack.emplace_back(a, middle, first->GetMiddle());
+    }
+}
+
+
+void ContractionHierarchy::Clear() {
+    rank.clear();
+    edgeIndex.clear();
+    upwardEdges.clear();
+}
+
+
+float ContractionSearch::GetDistance(const ContractionHierarchy& hierarchy, int fromNode, int toNode, std::vector<int>* nodePath) {
+    const int numNodes = hierarchy.GetNumNodes();
+    const std::vector<ContractionEdge>& edges = hierarchy.GetUpwardEdges();
+
+    numSettled = 0;
+
+    for (int d = 0; d < 2; ++d) {
+        if (visited[d].size() != numNodes) {
+            distances[d].resize(numNodes);
+            parentEdge[d].resize(numNodes);
+            parentNode[d].resize(numNodes);
+            visited[d].assign(numNodes, 0);
+            stamp = 0;
+        }
+    }
+
+    if (++stamp == 0) {
+        std::fill(visited[0].begin(), visited[0].end(), 0);
+        std::fill(visited[1].begin(), visited[1].end(), 0);
+        stamp = 1;
+    }
+
+    MinQueue queues[2];
+    const int roots[2] = {fromNode, toNode};
+
+    for (int d = 0; d < 2; ++d) {
+        visited[d][roots[d]] = stamp;
+        distances[d][roots[d]] = 0;
+        parentEdge[d][roots[d]] = -1;
+        queues[d].push(QueueEntry{0, roots[d]});
+    }
+
+    float best = std::numeric_limits<float>::max();
+    int meeting = -1;
+
+    // Alternate directions, a direction stops once its minimum reaches the best meeting
+    while (queues[0].size() > 0 || queues[1].size() > 0) {
+        for (int d = 0; d < 2; ++d) {
+            MinQueue& queue = queues[d];
+
+            while (queue.size() > 0 && queue.top().key > distances[d][queue.top().node]) {
+                queue.pop();
+            }
+
+            if (queue.size() == 0) continue;
+
+            if (queue.top().key >= best) {
+                queue = MinQueue();
+                continue;
+            }
+
+            const QueueEntry current = queue.top();
+            queue.pop();
+
+            numSettled++;
+
+            if (visited[d ^ 1][current.node] == stamp) {
+                const float dist = current.key + distances[d ^ 1][current.node];
+                if (dist < best) {
+                    best = dist;
+                    meeting = current.node;
+                }
+            }
+
+            const int begin = hierarchy.GetEdgeIndex(current.node);
+
+            for (int i = begin; i < begin + hierarchy.GetNumEdges(current.node); ++i) {
+                const int next = edges[i].GetTarget();
+                const float dist = current.key + edges[i].GetDist();
+
+                if (visited[d][next] != stamp || dist < distances[d][next]) {
+                    visited[d][next] = stamp;
+                    distances[d][next] = dist;
+                    parentEdge[d][next] = i;
+                    parentNode[d][next] = current.node;
+                    queue.push(QueueEntry{dist, next});
+                }
+            }
+        }
+    }
+
+    if (meeting == -1 || nodePath == nullptr) {
+        return best;
+    }
+
+    // Unpack the forward half from the source, then the backward half to the target
+    nodePath->clear();
+
+    std::vector<int> forward;
+    for (int node = meeting; node != fromNode; node = parentNode[0][node]) {
+        forward.push_back(node);
+    }
+
+    nodePath->push_back(fromNode);
+
+    for (int i = forward.size() - 1; i >= 0; --i) {
+        const int node = forward[i];
+        hierarchy.Unpack(parentNode[0][node], edges[parentEdge[0][node]], *nodePath);
+    }
+
+    for (int node = meeting; node != toNode; node = parentNode[1][node]) {
+        const ContractionEdge& edge = edges[parentEdge[1][node]];
+        hierarchy.Unpack(node, ContractionEdge(parentNode[1][node], edge.GetDist(), edge.GetMiddle()), *nodePath);
+    }
+
+    return best;
+}
+
+
+// Returns a list of x y coords
+std::vector<int> ContractionSearch::GetPath(
+    const Quadtree& quadtree, const AstarGraph& graph, const ContractionHierarchy& hierarchy,
+    int fromX, int fromY, int toX, int toY
+) {
+    std::vector<int> path; // xyxyxy...
+
+    const int fromNode = quadtree.QueryValidRegion((uint32_t)fromX, (uint32_t)fromY);
+    const int toNode = quadtree.QueryValidRegion((uint32_t)toX, (uint32_t)toY);
+
+    if (fromNode == -1 || toNode == -1) {
+        return path;
+    }
+
+    // They are in the same region.
+    if (fromNode == toNode) {
+        path.emplace_back(fromX);
+        path.emplace_back(fromY);
+        path.emplace_back(toX);
+        path.emplace_back(toY);
+        return path;
+    }
+
+    std::vector<int> nodePath;
+    if (this->GetDistance(hierarchy, fromNode, toNode, &nodePath) == std::numeric_limits<float>::max()) {
+        return path;
+    }
+
+    const std::vector<AstarNode>& nodes = graph.GetNodes();
+
+    path.reserve(nodePath.size() * 2 + 4);
+    path.emplace_back(fromX);
+    path.emplace_back(fromY);
+
+    for (int node : nodePath) {
+        path.emplace_back(nodes[node].GetX());
+        path.emplace_back(nodes[node].GetY());
+    }
+
+    path.emplace_back(toX);
+    path.emplace_back(toY);
+
+    return path;
+}
+
+
+void ManyToManySearch::SearchUpward(const ContractionHierarchy& hierarchy, Workspace& workspace, int root) {
+    const int numNodes = hierarchy.GetNumNodes();
+    const std::vector<ContractionEdge>& edges = hierarchy.GetUpwardEdges();
+
+    if (workspace.visited.size() != numNodes) {
+        workspace.distances.resize(numNodes);
+        workspace.visited.assign(numNodes, 0);
+        workspace.stamp = 0;
+    }
+
+    if (++workspace.stamp == 0) {
+        std::fill(workspace.visited.begin(), workspace.visited.end(), 0);
+        workspace.stamp = 1;
+    }
+
+    workspace.settled.clear();
+
+    MinQueue queue;
+
+    workspace.visited[root] = workspace.stamp;
+    workspace.distances[root] = 0;
+    queue.push(QueueEntry{0, root});
+
+    while (queue.size() > 0) {
+        const QueueEntry current = queue.top();
+        queue.pop();
+
+        if (current.key > workspace.distances[current.node]) continue;
+
+        workspace.settled.push_back(current.node);
+
+        const int begin = hierarchy.GetEdgeIndex(current.node);
+
+        for (int i = begin; i < begin + hierarchy.GetNumEdges(current.node); ++i) {
+            const int next = edges[i].GetTarget();
+            const float dist = current.key + edges[i].GetDist();
+
+            if (workspace.visited[next] != workspace.stamp || dist < workspace.distances[next]) {
+                workspace.visited[next] = workspace.stamp;
+                workspace.distances[next] = dist;
+                queue.push(QueueEntry{dist, next});
+            }
+        }
+    }
+}
+
+
+std::vector<float> ManyToManySearch::GetNodeDistances(
+    const ContractionHierarchy& hierarchy,
+    const std::vector<int>& sourceNodes, const std::vector<int>& targetNodes
+) {
+    const int numNodes = hierarchy.GetNumNodes();
+    const int numSources = sourceNodes.size();
+    const int numTargets = targetNodes.size();
+    const float infinite = std::numeric_limits<float>::max();
+
+    std::vector<float> matrix((size_t)numSources * numTargets, infinite);
+
+    workspaces.resize(Parallel::GetNumThreads());
+
+    // Upward search space of every target
+    std::vector<std::vector<std::pair<int, float>>> spaces(numTargets);
+
+    Parallel::ForStealing(numTargets, workspaces.size(), [&](int t, int thread) {
+        if (targetNodes[t] == -1) return;
+
+        Workspace& workspace = workspaces[thread];
+        this->SearchUpward(hierarchy, workspace, targetNodes[t]);
+
+        spaces[t].reserve(workspace.settled.size());
+        for (int node : workspace.settled) {
+            spaces[t].emplace_back(node, workspace.distances[node]);
+        }
+    });
+
+    // Counting sort of the search spaces into per node buckets
+    bucketIndex.assign(numNodes + 1, 0);
+
+    for (const std::vector<std::pair<int, float>>& space : spaces) {
+        for (const std::pair<int, float>& entry : space) {
+            bucketIndex[entry.first + 1]++;
+        }
+    }
+
+    for (int i = 0; i < numNodes; ++i) {
+        bucketIndex[i + 1] += bucketIndex[i];
+    }
+
+    buckets.resize(bucketIndex[numNodes]);
+
+    std::vector<int> fill(bucketIndex.begin(), bucketIndex.end() - 1);
+
+    for (int t = 0; t < numTargets; ++t) {
+        for (const std::pair<int, float>& entry : spaces[t]) {
+            buckets[fill[entry.first]++] = BucketEntry{t, entry.second};
+        }
+    }
+
+    spaces.clear();
+    spaces.shrink_to_fit();
+
+    // Every source fills its own row
+    Parallel::ForStealing(numSources, workspaces.size(), [&](int s, int thread) {
+        if (sourceNodes[s] == -1) return;
+
+        Workspace& workspace = workspaces[thread];
+        this->SearchUpward(hierarchy, workspace, sourceNodes[s]);
+
+        float* row = &matrix[(size_t)s * numTargets];
+
+        for (int node : workspace.settled) {
+            const float dist = workspace.distances[node];
+
+            for (int i = bucketIndex[node]; i < bucketIndex[node + 1]; ++i) {
+                const float total = dist + buckets[i].dist;
+
+                if (total < row[buckets[i].target]) {
+                    row[buckets[i].target] = total;
+                }
+            }
+        }
+    });
+
+    for (float& dist : matrix) {
+        if (dist == infinite) dist = -1;
+    }
+
+    return matrix;
+}
+
+
+std::vector<float> ManyToManySearch::GetDistances(
+    const Quadtree& quadtree, const AstarGraph& graph, const ContractionHierarchy& hierarchy,
+    const std::vector<int>& sources, const std::vector<int>& targets
+) {
+    const std::vector<AstarNode>& nodes = graph.GetNodes();
+
+    std::vector<int> sourceNodes(sources.size() / 2);
+    std::vector<int> targetNodes(targets.size() / 2);
+
+    for (int i = 0; i < sourceNodes.size(); ++i) {
+        sourceNodes[i] = quadtree.QueryValidRegion((uint32_t)sources[2 * i], (uint32_t)sources[2 * i + 1]);
+    }
+
+    for (int i = 0; i < targetNodes.size(); ++i) {
+        targetNodes[i] = quadtree.QueryValidRegion((uint32_t)targets[2 * i], (uint32_t)targets[2 * i + 1]);
+    }
+
+    std::vector<float> matrix = this->GetNodeDistances(hierarchy, sourceNodes, targetNodes);
+
+    // Add the legs between the points and their leaf centres like GetPath does
+    for (int s = 0; s < sourceNodes.size(); ++s) {
+        for (int t = 0; t < targetNodes.size(); ++t) {
+            float& dist = matrix[(size_t)s * targetNodes.size() + t];
+
+            if (dist < 0) continue;
+
+            const float fromX = sources[2 * s];
+            const float fromY = sources[2 * s + 1];
+            const float toX = targets[2 * t];
+            const float toY = targets[2 * t + 1];
+
+            if (sourceNodes[s] == targetNodes[t]) {
+                dist = std::hypot(toX - fromX, toY - fromY);
+                continue;
+            }
+
+            const AstarNode& from = nodes[sourceNodes[s]];
+            const AstarNode& to = nodes[targetNodes[t]];
+
+            dist += std::hypot(from.GetX() - fromX, from.GetY() - fromY);
+            dist += std::hypot(toX - to.GetX(), toY - to.GetY());
+        }
+    }
+
+    return matrix;
+}
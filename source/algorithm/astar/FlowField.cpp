@@ -0,0 +1,126 @@
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <vector>
+
+#include "AstarGraph.hpp"
+#include "FlowField.hpp"
+#include "Quadtree.hpp"
+
+
+namespace {
+    struct QueueEntry {
+        float key;
+        int node;
+
+        bool operator>(const QueueEntry& other) const {
+            return key > other.key;
+        }
+    };
+}
+
+
+bool FlowField::Build(const Quadtree& quadtree, const AstarGraph& graph, int goalX, int goalY) {
+    this->Clear();
+
+    this->version = quadtree.GetVersion();
+    this->goalX = goalX;
+    this->goalY = goalY;
+    this->goalLeaf = quadtree.QueryValidRegion((uint32_t)goalX, (uint32_t)goalY);
+
+    if (goalLeaf == -1) {
+        return false;
+    }
+
+    const std::vector<AstarNode>& nodes = graph.GetNodes();
+    const std::vector<AstarEdge>& edges = graph.GetEdges();
+
+    distances.assign(nodes.size(), -1);
+    nextLeaf.assign(nodes.size(), -1);
+
+    // The leaf graph is undirected, so distances from the goal are distances to it
+    std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>> queue;
+
+    distances[goalLeaf] = 0;
+    queue.push(QueueEntry{0, goalLeaf});
+
+    while (queue.size() > 0) {
+        const QueueEntry current = queue.top();
+        queue.pop();
+
+        if (current.key > distances[current.node]) continue;
+
+        const AstarNode& node = nodes[current.node];
+
+        for (int i = node.GetEdgeIndex(); i < node.GetEdgeIndex() + node.GetNumEdges(); ++i) {
+            const int next = edges[i].GetNodeIdB();
+            const float distance = current.key + edges[i].GetDist();
+
+            if (distances[next] == -1 || distance < distances[next]) {
+                distances[next] = distance;
+                nextLeaf[next] = current.node;
+                queue.push(QueueEntry{distance, next});
+            }
+        }
+    }
+
+    return true;
+}
+
+
+bool FlowField::Update(const Quadtree& quadtree, const AstarGraph& graph, int goalX, int goalY) {
+    if (quadtree.GetVersion() == version && goalX == this->goalX && goalY == this->goalY) {
+        return goalLeaf != -1;
+    }
+
+    // Inside the same goal leaf only the final target moves
+    if (quadtree.GetVersion() == version && goalLeaf != -1
+        && quadtree.QueryValidRegion((uint32_t)goalX, (uint32_t)goalY) == goalLeaf) {
+        this->goalX = goalX;
+        this->goalY = goalY;
+        return true;
+    }
+
+    return this->Build(quadtree, graph, goalX, goalY);
+}
+
+
+bool FlowField::NextDirection(const Quadtree& quadtree, const AstarGraph& graph, int x, int y, float& dirX, float& dirY) const {
+    dirX = 0;
+    dirY = 0;
+
+    const int leaf = quadtree.QueryValidRegion((uint32_t)x, (uint32_t)y);
+
+    if (leaf == -1 || goalLeaf == -1 || distances[leaf] == -1) {
+        return false;
+    }
+
+    // Head for the centre of the next leaf, or straight for the goal inside its leaf
+    float targetX = goalX;
+    float targetY = goalY;
+
+    if (leaf != goalLeaf) {
+        targetX = graph.GetNodes()[nextLeaf[leaf]].GetX();
+        targetY = graph.GetNodes()[nextLeaf[leaf]].GetY();
+    }
+
+    const float dX = targetX - x;
+    const float dY = targetY - y;
+    const float length = std::sqrt(dX * dX + dY * dY);
+
+    if (length > 0) {
+        dirX = dX / length;
+        dirY = dY / length;
+    }
+
+    return true;
+}
+
+
+void FlowField::Clear() {
+    version = 0;
+    goalLeaf = -1;
+    distances.clear();
+    nextLeaf.clear();
+}
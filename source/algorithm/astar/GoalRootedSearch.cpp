@@ -0,0 +1,155 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <vector>
+
+#include "AstarGraph.hpp"
+#include "GoalRootedSearch.hpp"
+#include "Quadtree.hpp"
+
+
+// Returns a list of x y coords
+std::vector<int> GoalRootedSearch::GetPath(
+    const Quadtree& quadtree, const AstarGraph& graph,
+    int fromX, int fromY, int toX, int toY
+) {
+    std::vector<int> path; // xyxyxy...
+
+    numExpanded = 0;
+
+    const int fromRegionIndex = quadtree.QueryValidRegion((uint32_t)fromX, (uint32_t)fromY);
+    const int toRegionIndex = quadtree.QueryValidRegion((uint32_t)toX, (uint32_t)toY);
+
+    if (fromRegionIndex == -1 || toRegionIndex == -1) {
+        return path;
+    }
+
+    // They are in the same region.
+    if (fromRegionIndex == toRegionIndex) {
+        path.emplace_back(fromX);
+        path.emplace_back(fromY);
+        path.emplace_back(toX);
+        path.emplace_back(toY);
+        return path;
+    }
+
+    if (quadtree.GetVersion() != version || toRegionIndex != goalNode) {
+        this->Reset(quadtree, graph, toRegionIndex);
+    }
+
+    const std::vector<AstarNode>& nodes = graph.GetNodes();
+    const std::vector<AstarEdge>& edges = graph.GetEdges();
+
+    // Resume towards the new start unless the tree already reaches it
+    if (closed[fromRegionIndex] != stamp) {
+        const int startX = nodes[fromRegionIndex].GetX();
+        const int startY = nodes[fromRegionIndex].GetY();
+
+        auto estimate = [&](int node) -> float {
+            const float dX = nodes[node].GetX() - startX;
+            const float dY = nodes[node].GetY() - startY;
+            return std::sqrt(dX * dX + dY * dY);
+        };
+
+        // Re-key the open list for the new start, dropping leafs closed since
+        std::vector<QueueEntry> entries;
+        int numOpen = 0;
+
+        for (int node : openNodes) {
+            if (closed[node] == stamp) continue;
+
+            openNodes[numOpen++] = node;
+            entries.push_back(QueueEntry{gScores[node] + estimate(node), node});
+        }
+
+        openNodes.resize(numOpen);
+
+        std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>> openSet(
+            std::greater<QueueEntry>(), std::move(entries));
+
+        while (openSet.size() > 0) {
+            const QueueEntry current = openSet.top();
+            openSet.pop();
+
+            if (closed[current.node] == stamp) continue;
+
+            closed[current.node] = stamp;
+            numExpanded++;
+
+            const AstarNode& currentNode = nodes[current.node];
+
+            for (int i = currentNode.GetEdgeIndex(); i < currentNode.GetEdgeIndex() + currentNode.GetNumEdges(); ++i) {
+                const int next = edges[i].GetNodeIdB();
+
+                if (closed[next] == stamp) continue;
+
+                const float gScore = gScores[current.node] + edges[i].GetDist();
+
+                if (visited[next] != stamp || gScore < gScores[next]) {
+                    if (visited[next] != stamp) {
+                        visited[next] = stamp;
+                        openNodes.push_back(next);
+                    }
+
+                    gScores[next] = gScore;
+                    parents[next] = current.node;
+                    openSet.push(QueueEntry{gScore + estimate(next), next});
+                }
+            }
+
+            // Expanded before stopping so the tree stays whole for later starts
+            if (current.node == fromRegionIndex) break;
+        }
+
+        // Nodes still queued stay in openNodes for the next query
+        if (closed[fromRegionIndex] != stamp) {
+            return path;
+        }
+    }
+
+    // Parents lead from the start to the goal
+    path.emplace_back(fromX);
+    path.emplace_back(fromY);
+
+    for (int node = fromRegionIndex; node != -1; node = parents[node]) {
+        path.emplace_back(nodes[node].GetX());
+        path.emplace_back(nodes[node].GetY());
+    }
+
+    path.emplace_back(toX);
+    path.emplace_back(toY);
+
+    return path;
+}
+
+
+void GoalRootedSearch::Reset(const Quadtree& quadtree, const AstarGraph& graph, int goalNode) {
+    const int numNodes = graph.GetNodes().size();
+
+    if (++stamp == 0 || visited.size() != numNodes) {
+        gScores.resize(numNodes);
+        parents.resize(numNodes);
+        visited.assign(numNodes, 0);
+        closed.assign(numNodes, 0);
+        stamp = 1;
+    }
+
+    this->version = quadtree.GetVersion();
+    this->goalNode = goalNode;
+
+    visited[goalNode] = stamp;
+    gScores[goalNode] = 0;
+    parents[goalNode] = -1;
+
+    openNodes.clear();
+    openNodes.push_back(goalNode);
+}
+
+
+void GoalRootedSearch::Clear() {
+    version = 0;
+    goalNode = -1;
+    openNodes.clear();
+}
@@ -0,0 +1,243 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "AstarGraph.hpp"
+#include "HashDistributedSearch.hpp"
+#include "Parallel.hpp"
+#include "Quadtree.hpp"
+
+
+namespace {
+    struct QueueEntry {
+        float key;
+        float gScore;
+        int node;
+
+        bool operator>(const QueueEntry& other) const {
+            return key > other.key;
+        }
+    };
+}
+
+
+HashDistributedSearch::HashDistributedSearch() {
+    this->SetNumThreads(Parallel::GetNumThreads());
+}
+
+
+void HashDistributedSearch::SetNumThreads(int numThreads) {
+#ifdef PLATFORM_WEB
+    numThreads = 1;
+#endif
+
+    this->numThreads = std::max(1, numThreads);
+    this->workers.reset(new Worker[this->numThreads]);
+}
+
+
+// Returns a list of x y coords
+std::vector<int> HashDistributedSearch::GetPath(
+    const Quadtree& quadtree, const AstarGraph& graph,
+    int fromX, int fromY, int toX, int toY
+) {
+    std::vector<int> path; // xyxyxy...
+
+    numExpanded = 0;
+
+    const int fromRegionIndex = quadtree.QueryValidRegion((uint32_t)fromX, (uint32_t)fromY);
+    const int toRegionIndex = quadtree.QueryValidRegion((uint32_t)toX, (uint32_t)toY);
+
+    if (fromRegionIndex == -1 || toRegionIndex == -1) {
+        return path;
+    }
+
+    // They are in the same region.
+    if (fromRegionIndex == toRegionIndex) {
+        path.emplace_back(fromX);
+        path.emplace_back(fromY);
+        path.emplace_back(toX);
+        path.emplace_back(toY);
+        return path;
+    }
+
+    const std::vector<AstarNode>& nodes = graph.GetNodes();
+    const std::vector<AstarEdge>& edges = graph.GetEdges();
+    const int numNodes = nodes.size();
+
+    if (++stamp == 0 || visited.size() != numNodes) {
+        gScores.resize(numNodes);
+        parents.resize(numNodes);
+        visited.assign(numNodes, 0);
+        stamp = 1;
+    }
+
+    for (int t = 0; t < numThreads; ++t) {
+        workers[t].inbox.store(nullptr);
+        workers[t].isIdle.store(false);
+        workers[t].sent.clear();
+        workers[t].numExpanded = 0;
+    }
+
+    const int goalX = nodes[toRegionIndex].GetX();
+    const int goalY = nodes[toRegionIndex].GetY();
+
+    auto estimate = [&](int node) -> float {
+        const float dX = nodes[node].GetX() - goalX;
+        const float dY = nodes[node].GetY() - goalY;
+        return std::sqrt(dX * dX + dY * dY);
+    };
+
+    // Best goal cost so far, work at or above it is pruned
+    std::atomic<float> incumbent(std::numeric_limits<float>::max());
+
+    // A message counts as sent before it is queued and as received once
+    // its receiver is marked busy, see the termination check below
+    std::atomic<long> numSent(0);
+    std::atomic<long> numReceived(0);
+    std::atomic<bool> isDone(false);
+
+    auto run = [&](int thread) {
+        Worker& worker = workers[thread];
+
+        std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>> openSet;
+
+        auto relax = [&](int node, float gScore, int parent) {
+            if (visited[node] == stamp && gScore >= gScores[node]) return;
+
+            const float fScore = gScore + estimate(node);
+
+            if (fScore >= incumbent.load(std::memory_order_relaxed)) return;
+
+            visited[node] = stamp;
+            gScores[node] = gScore;
+            parents[node] = parent;
+            openSet.push(QueueEntry{fScore, gScore, node});
+        };
+
+        if (this->GetOwner(fromRegionIndex) == thread) {
+            relax(fromRegionIndex, 0, -1);
+        }
+
+        while (!isDone.load()) {
+            Message* message = worker.inbox.exchange(nullptr);
+
+            if (message != nullptr) {
+                worker.isIdle.store(false);
+
+                long count = 0;
+                for (; message != nullptr; message = message->next) {
+                    relax(message->node, message->gScore, message->parent);
+                    count++;
+                }
+
+                numReceived.fetch_add(count);
+            }
+
+            if (openSet.size() > 0 && openSet.top().key < incumbent.load()) {
+                const QueueEntry current = openSet.top();
+                openSet.pop();
+
+                // Stale copy of a leaf that was improved since
+                if (current.gScore != gScores[current.node]) continue;
+
+                if (current.node == toRegionIndex) {
+                    float best = incumbent.load();
+                    while (current.gScore < best && !incumbent.compare_exchange_weak(best, current.gScore)) {}
+                    continue;
+                }
+
+                worker.numExpanded++;
+
+                const AstarNode& currentNode = nodes[current.node];
+
+                for (int i = currentNode.GetEdgeIndex(); i < currentNode.GetEdgeIndex() + currentNode.GetNumEdges(); ++i) {
+                    const int next = edges[i].GetNodeIdB();
+                    const float gScore = current.gScore + edges[i].GetDist();
+
+                    if (gScore + estimate(next) >= incumbent.load(std::memory_order_relaxed)) continue;
+
+                    const int owner = this->GetOwner(next);
+
+                    if (owner == thread) {
+                        relax(next, gScore, current.node);
+                        continue;
+                    }
+
+                    Message& sent = worker.sent.emplace_back(Message{next, current.node, gScore, nullptr});
+                    numSent.fetch_add(1);
+
+                    std::atomic<Message*>& inbox = workers[owner].inbox;
+                    sent.next = inbox.load(std::memory_order_relaxed);
+                    while (!inbox.compare_exchange_weak(sent.next, &sent)) {}
+                }
+
+                continue;
+            }
+
+            // Everything left costs at least the incumbent, which only drops
+            while (openSet.size() > 0) {
+                openSet.pop();
+            }
+
+            worker.isIdle.store(true);
+
+            // Received is read before the idle flags and sent after them. If
+            // they match, nothing was in flight or sent while every worker
+            // was seen idle, and only a message can wake an idle worker.
+            const long received = numReceived.load();
+
+            bool isAllIdle = true;
+            for (int t = 0; t < numThreads && isAllIdle; ++t) {
+                isAllIdle = workers[t].isIdle.load();
+            }
+
+            if (isAllIdle && numSent.load() == received) {
+                isDone.store(true);
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int t = 1; t < numThreads; ++t) {
+        threads.emplace_back(run, t);
+    }
+
+    run(0);
+
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    for (int t = 0; t < numThreads; ++t) {
+        numExpanded += workers[t].numExpanded;
+    }
+
+    // Parents lead back from the goal with strictly falling gScores
+    if (visited[toRegionIndex] == stamp) {
+        std::vector<int> leafPath;
+        for (int node = toRegionIndex; node != -1; node = parents[node]) {
+            leafPath.emplace_back(node);
+        }
+
+        path.emplace_back(fromX);
+        path.emplace_back(fromY);
+
+        for (int i = leafPath.size() - 1; i >= 0; --i) {
+            path.emplace_back(nodes[leafPath[i]].GetX());
+            path.emplace_back(nodes[leafPath[i]].GetY());
+        }
+
+        path.emplace_back(toX);
+        path.emplace_back(toY);
+    }
+
+    return path;
+}
@@ -0,0 +1,446 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <vector>
+
+#include "ankerl/unordered_dense.h"
+
+#include "AstarGraph.hpp"
+#include "HierarchicalGraph.hpp"
+#include "Parallel.hpp"
+#include "Quadtree.hpp"
+
+
+namespace {
+    struct QueueEntry {
+        float key;
+        int node;
+
+        bool operator>(const QueueEntry& other) const {
+            return key > other.key;
+        }
+    };
+
+    using MinQueue = std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>>;
+
+    // Dijkstra from source over the leaf nodes of its cluster
+    void ClusterDistances(
+        const AstarGraph& graph,
+        const HierarchicalGraph& hierarchy,
+        int source,
+        ankerl::unordered_dense::map<int, float>& distances
+    ) {
+        const std::vector<AstarNode>& nodes = graph.GetNodes();
+        const std::vector<AstarEdge>& edges = graph.GetEdges();
+        const int cluster = hierarchy.GetCluster(source);
+
+        distances.clear();
+        distances.emplace(source, 0);
+
+        MinQueue queue;
+        queue.push(QueueEntry{0, source});
+
+        while (queue.size() > 0) {
+            const QueueEntry current = queue.top();
+            queue.pop();
+
+            if (current.key > distances[current.node]) continue;
+
+            const AstarNode& node = nodes[current.node];
+
+            for (int i = node.GetEdgeIndex(); i < node.GetEdgeIndex() + node.GetNumEdges(); ++i) {
+                const int next = edges[i].GetNodeIdB();
+                if (hierarchy.GetCluster(next) != cluster) continue;
+
+                const float distance = current.key + edges[i].GetDist();
+                auto iterator = distances.find(next);
+
+                if (iterator == distances.end() || distance < iterator->second) {
+                    distances.insert_or_assign(next, distance);
+                    queue.push(QueueEntry{distance, next});
+                }
+            }
+        }
+    }
+
+    int FindRoot(std::vector<int>& unionParent, int i) {
+        while (unionParent[i] != i) {
+            unionParent[i] = unionParent[unionParent[i]];
+            i = unionParent[i];
+        }
+        return i;
+    }
+
+    void Union(std::vector<int>& unionParent, int a, int b) {
+        a = FindRoot(unionParent, a);
+        b = FindRoot(unionParent, b);
+        if (a != b) unionParent[a] = b;
+    }
+}
+
+
+void HierarchicalGraph::Build(const Quadtree& quadtree, const AstarGraph& graph, int clusterLevel) {
+    this->Clear();
+
+    const std::vector<Quadrant>& leafs = quadtree.GetLeafs();
+    const std::vector<AstarNode>& nodes = graph.GetNodes();
+    const std::vector<AstarEdge>& graphEdges = graph.GetEdges();
+
+    const int resolution = quadtree.GetResolution();
+    const int level = std::clamp(clusterLevel, 0, resolution);
+    const int shift = 2 * (resolution - level);
+
+    // Only blocks holding a leaf get a cluster, numbered as they are met,
+    // so deep cluster levels cost nothing for the blocks that stay empty
+    ankerl::unordered_dense::map<uint64_t, int> clusterIndex;
+
+    clusterOf.resize(nodes.size());
+    for (int i = 0; i < nodes.size(); ++i) {
+        const uint64_t block = shift >= 64 ? 0 : leafs[i].GetCode() >> shift;
+        clusterOf[i] = clusterIndex.try_emplace(block, (int)clusterIndex.size()).first->second;
+    }
+
+    clusterEntrances.resize(clusterIndex.size());
+
+    // Group the leaf edges between two clusters into entrances
+    std::vector<int> unionParent(graphEdges.size());
+    for (int i = 0; i < graphEdges.size(); ++i) {
+        unionParent[i] = i;
+    }
+
+    for (int u = 0; u < nodes.size(); ++u) {
+        const int uBegin = nodes[u].GetEdgeIndex();
+        const int uEnd = uBegin + nodes[u].GetNumEdges();
+
+        for (int e = uBegin; e < uEnd; ++e) {
+            const int v = graphEdges[e].GetNodeIdB();
+            if (clusterOf[v] == clusterOf[u]) continue;
+
+            // Both directions of an edge, and edges of the same leaf into the same cluster
+            for (int r = nodes[v].GetEdgeIndex(); r < nodes[v].GetEdgeIndex() + nodes[v].GetNumEdges(); ++r) {
+                if (graphEdges[r].GetNodeIdB() == u) Union(unionParent, e, r);
+            }
+
+            for (int f = uBegin; f < uEnd; ++f) {
+                if (clusterOf[graphEdges[f].GetNodeIdB()] == clusterOf[v]) Union(unionParent, e, f);
+            }
+
+            // Neighbouring leafs of the same cluster crossing into the same cluster
+            for (int n = uBegin; n < uEnd; ++n) {
+                const int u2 = graphEdges[n].GetNodeIdB();
+                if (clusterOf[u2] != clusterOf[u]) continue;
+
+                for (int f = nodes[u2].GetEdgeIndex(); f < nodes[u2].GetEdgeIndex() + nodes[u2].GetNumEdges(); ++f) {
+                    if (clusterOf[graphEdges[f].GetNodeIdB()] == clusterOf[v]) Union(unionParent, e, f);
+                }
+            }
+        }
+    }
+
+    // The widest crossing of every entrance becomes its pair of abstract nodes
+    ankerl::unordered_dense::map<int, int> bestCrossing;
+
+    auto crossingWidth = [&](int u, int e) -> int {
+        return std::min(
+            resolution - leafs[u].GetLevel(),
+            resolution - leafs[graphEdges[e].GetNodeIdB()].GetLevel()
+        );
+    };
+
+    std::vector<int> crossingSource(graphEdges.size(), -1);
+
+    for (int u = 0; u < nodes.size(); ++u) {
+        for (int e = nodes[u].GetEdgeIndex(); e < nodes[u].GetEdgeIndex() + nodes[u].GetNumEdges(); ++e) {
+            if (clusterOf[graphEdges[e].GetNodeIdB()] == clusterOf[u]) continue;
+
+            crossingSource[e] = u;
+
+            const int root = FindRoot(unionParent, e);
+            auto iterator = bestCrossing.find(root);
+
+            if (iterator == bestCrossing.end()) {
+                bestCrossing.emplace(root, e);
+            } else if (crossingWidth(u, e) > crossingWidth(crossingSource[iterator->second], iterator->second)) {
+                iterator->second = e;
+            }
+        }
+    }
+
+    abstractOf.assign(nodes.size(), -1);
+
+    for (const auto& [root, e] : bestCrossing) {
+        abstractOf[crossingSource[e]] = 0;
+        abstractOf[graphEdges[e].GetNodeIdB()] = 0;
+    }
+
+    for (int i = 0; i < nodes.size(); ++i) {
+        if (abstractOf[i] == -1) continue;
+
+        abstractOf[i] = abstractNodes.size();
+        abstractNodes.push_back(i);
+        clusterEntrances[clusterOf[i]].push_back(abstractOf[i]);
+    }
+
+    std::vector<std::vector<AstarEdge>> adjacency(abstractNodes.size());
+
+    for (const auto& [root, e] : bestCrossing) {
+        const int a = abstractOf[crossingSource[e]];
+        const int b = abstractOf[graphEdges[e].GetNodeIdB()];
+        adjacency[a].emplace_back(b, graphEdges[e].GetDist());
+        adjacency[b].emplace_back(a, graphEdges[e].GetDist());
+    }
+
+    // Cache the distances between the entrances of every cluster
+    Parallel::For(clusterEntrances.size(), [&](int cluster) {
+        ankerl::unordered_dense::map<int, float> distances;
+
+        for (int a : clusterEntrances[cluster]) {
+            ClusterDistances(graph, *this, abstractNodes[a], distances);
+
+            for (int b : clusterEntrances[cluster]) {
+                if (a == b) continue;
+
+                auto iterator = distances.find(abstractNodes[b]);
+                if (iterator != distances.end()) {
+                    adjacency[a].emplace_back(b, iterator->second);
+                }
+            }
+        }
+    });
+
+    edgeIndex.resize(abstractNodes.size() + 1);
+    edgeIndex[0] = 0;
+
+    for (int a = 0; a < abstractNodes.size(); ++a) {
+        edgeIndex[a + 1] = edgeIndex[a] + adjacency[a].size();
+        edges.insert(edges.end(), adjacency[a].begin(), adjacency[a].end());
+    }
+}
+
+
+void HierarchicalGraph::Clear() {
+    clusterOf.clear();
+    abstractOf.clear();
+    abstractNodes.clear();
+    clusterEntrances.clear();
+    edgeIndex.clear();
+    edges.clear();
+}
+
+
+// Returns a list of x y coords
+std::vector<int> HierarchicalSearch::GetPath(
+    const Quadtree& quadtree, const AstarGraph& graph, const HierarchicalGraph& hierarchy,
+    int fromX, int fromY, int toX, int toY
+) {
+    std::vector<int> path; // xyxyxy...
+
+    numExpanded = 0;
+
+    const int fromNode = quadtree.QueryValidRegion((uint32_t)fromX, (uint32_t)fromY);
+    const int toNode = quadtree.QueryValidRegion((uint32_t)toX, (uint32_t)toY);
+
+    if (fromNode == -1 || toNode == -1) {
+        return path;
+    }
+
+    // They are in the same region.
+    if (fromNode == toNode) {
+        path.emplace_back(fromX);
+        path.emplace_back(fromY);
+        path.emplace_back(toX);
+        path.emplace_back(toY);
+        return path;
+    }
+
+    const std::vector<AstarNode>& nodes = graph.GetNodes();
+
+    allowedClusters.assign(hierarchy.GetNumClusters(), 0);
+
+    const int fromCluster = hierarchy.GetCluster(fromNode);
+    const int toCluster = hierarchy.GetCluster(toNode);
+
+    bool isPathFound = false;
+
+    if (fromCluster == toCluster) {
+        allowedClusters[fromCluster] = 1;
+        isPathFound = this->RefinePath(graph, hierarchy, fromNode, toNode, toX, toY);
+    }
+
+    if (!isPathFound) {
+        // Connect both endpoints to the entrances of their clusters
+        ankerl::unordered_dense::map<int, float> fromDistances;
+        ankerl::unordered_dense::map<int, float> toDistances;
+        ClusterDistances(graph, hierarchy, fromNode, fromDistances);
+        ClusterDistances(graph, hierarchy, toNode, toDistances);
+
+        const int numAbstract = hierarchy.GetNumAbstractNodes();
+        const int source = numAbstract;
+        const int target = numAbstract + 1;
+
+        const std::vector<AstarEdge>& edges = hierarchy.GetEdges();
+
+        std::vector<float> abstractScores(numAbstract + 2, std::numeric_limits<float>::max());
+        std::vector<int> abstractParent(numAbstract + 2, -1);
+
+        auto heuristic = [&](int abstractNode) -> float {
+            if (abstractNode == target) return 0;
+
+            const AstarNode& node = nodes[abstractNode == source ? fromNode : hierarchy.GetLeafNode(abstractNode)];
+            const float dX = node.GetX() - toX;
+            const float dY = node.GetY() - toY;
+            return std::sqrt(dX * dX + dY * dY);
+        };
+
+        MinQueue openSet;
+        abstractScores[source] = 0;
+        openSet.push(QueueEntry{heuristic(source), source});
+
+        auto relax = [&](int current, int next, float dist) {
+            const float gScore = abstractScores[current] + dist;
+            if (gScore < abstractScores[next]) {
+                abstractScores[next] = gScore;
+                abstractParent[next] = current;
+                openSet.push(QueueEntry{gScore + heuristic(next), next});
+            }
+        };
+
+        bool isAbstractFound = false;
+
+        while (openSet.size() > 0) {
+            const QueueEntry current = openSet.top();
+            openSet.pop();
+
+            if (current.node == target) {
+                isAbstractFound = true;
+                break;
+            }
+
+            if (current.key > abstractScores[current.node] + heuristic(current.node)) continue;
+
+            numExpanded++;
+
+            if (current.node == source) {
+                for (int a : hierarchy.GetEntrances(fromCluster)) {
+                    auto iterator = fromDistances.find(hierarchy.GetLeafNode(a));
+                    if (iterator != fromDistances.end()) relax(source, a, iterator->second);
+                }
+                continue;
+            }
+
+            const int begin = hierarchy.GetEdgeIndex(current.node);
+            for (int i = begin; i < begin + hierarchy.GetNumEdges(current.node); ++i) {
+                relax(current.node, edges[i].GetNodeIdB(), edges[i].GetDist());
+            }
+
+            if (hierarchy.GetCluster(hierarchy.GetLeafNode(current.node)) == toCluster) {
+                auto iterator = toDistances.find(hierarchy.GetLeafNode(current.node));
+                if (iterator != toDistances.end()) relax(current.node, target, iterator->second);
+            }
+        }
+
+        if (!isAbstractFound) {
+            return path;
+        }
+
+        // Refine inside the clusters of the abstract path only
+        allowedClusters[fromCluster] = 1;
+        allowedClusters[toCluster] = 1;
+
+        for (int a = abstractParent[target]; a != source; a = abstractParent[a]) {
+            allowedClusters[hierarchy.GetCluster(hierarchy.GetLeafNode(a))] = 1;
+        }
+
+        isPathFound = this->RefinePath(graph, hierarchy, fromNode, toNode, toX, toY);
+    }
+
+    // Reconstruct path
+    if (isPathFound) {
+        std::vector<int> corridor;
+        for (int node = toNode; node != -1; node = parent[node]) {
+            corridor.push_back(node);
+        }
+
+        path.reserve(corridor.size() * 2 + 4);
+        path.emplace_back(fromX);
+        path.emplace_back(fromY);
+
+        for (int i = corridor.size() - 1; i >= 0; --i) {
+            path.emplace_back(nodes[corridor[i]].GetX());
+            path.emplace_back(nodes[corridor[i]].GetY());
+        }
+
+        path.emplace_back(toX);
+        path.emplace_back(toY);
+    }
+
+    return path;
+}
+
+
+bool HierarchicalSearch::RefinePath(
+    const AstarGraph& graph, const HierarchicalGraph& hierarchy,
+    int fromNode, int toNode, int toX, int toY
+) {
+    const std::vector<AstarNode>& nodes = graph.GetNodes();
+    const std::vector<AstarEdge>& edges = graph.GetEdges();
+
+    if (visited.size() != nodes.size()) {
+        gScores.resize(nodes.size());
+        parent.resize(nodes.size());
+        visited.assign(nodes.size(), 0);
+        stamp = 0;
+    }
+
+    if (++stamp == 0) {
+        std::fill(visited.begin(), visited.end(), 0);
+        stamp = 1;
+    }
+
+    MinQueue openSet;
+
+    visited[fromNode] = stamp;
+    gScores[fromNode] = 0;
+    parent[fromNode] = -1;
+    openSet.push(QueueEntry{0, fromNode});
+
+    while (openSet.size() > 0) {
+        const QueueEntry current = openSet.top();
+        openSet.pop();
+
+        if (current.node == toNode) {
+            return true;
+        }
+
+        const AstarNode& currentNode = nodes[current.node];
+        const float dX = currentNode.GetX() - toX;
+        const float dY = currentNode.GetY() - toY;
+
+        if (current.key > gScores[current.node] + std::sqrt(dX * dX + dY * dY)) continue;
+
+        numExpanded++;
+
+        for (int i = currentNode.GetEdgeIndex(); i < currentNode.GetEdgeIndex() + currentNode.GetNumEdges(); ++i) {
+            const int nextNodeIndex = edges[i].GetNodeIdB();
+
+            if (!allowedClusters[hierarchy.GetCluster(nextNodeIndex)]) continue;
+
+            const float gScore = gScores[current.node] + edges[i].GetDist();
+
+            if (visited[nextNodeIndex] != stamp || gScore < gScores[nextNodeIndex]) {
+                visited[nextNodeIndex] = stamp;
+                gScores[nextNodeIndex] = gScore;
+                parent[nextNodeIndex] = current.node;
+
+                const float nX = nodes[nextNodeIndex].GetX() - toX;
+                const float nY = nodes[nextNodeIndex].GetY() - toY;
+                openSet.push(QueueEntry{gScore + std::sqrt(nX * nX + nY * nY), nextNodeIndex});
+            }
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,317 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "AstarGraph.hpp"
+#include "IncrementalSearch.hpp"
+#include "Quadtree.hpp"
+
+
+namespace {
+    constexpr float INFINITE = std::numeric_limits<float>::max();
+}
+
+
+// Returns a list of x y coords
+std::vector<int> IncrementalSearch::GetPath(
+    const Quadtree& quadtree, const AstarGraph& graph,
+    int fromX, int fromY, int toX, int toY
+) {
+    std::vector<int> path; // xyxyxy...
+
+    numExpanded = 0;
+
+    const int fromRegionIndex = quadtree.QueryValidRegion((uint32_t)fromX, (uint32_t)fromY);
+    const int toRegionIndex = quadtree.QueryValidRegion((uint32_t)toX, (uint32_t)toY);
+
+    if (fromRegionIndex == -1 || toRegionIndex == -1) {
+        return path;
+    }
+
+    // They are in the same region.
+    if (fromRegionIndex == toRegionIndex) {
+        path.emplace_back(fromX);
+        path.emplace_back(fromY);
+        path.emplace_back(toX);
+        path.emplace_back(toY);
+        return path;
+    }
+
+    const std::vector<Quadrant>& leafs = quadtree.GetLeafs();
+
+    const bool isSameEnds = fromNode != -1
+        && fromKey == LeafKey(leafs[fromRegionIndex])
+        && toKey == LeafKey(leafs[toRegionIndex]);
+
+    if (!isSameEnds) {
+        this->Reset(quadtree, graph, fromRegionIndex, toRegionIndex);
+    } else if (quadtree.GetVersion() != version) {
+        this->Remap(quadtree, graph);
+    }
+
+    this->ComputeShortestPath();
+
+    if (g[toNode] == INFINITE) {
+        return path;
+    }
+
+    // Walk back from the goal along the best consistent predecessors, vertices
+    // left inconsistent above the goal key may hold outdated g values
+    const std::vector<AstarNode>& nodes = graph.GetNodes();
+    const std::vector<AstarEdge>& edges = graph.GetEdges();
+
+    path.emplace_back(toY);
+    path.emplace_back(toX);
+
+    int currentNodeIndex = toNode;
+
+    for (int steps = 0; steps < nodes.size(); ++steps) {
+        path.emplace_back(nodes[currentNodeIndex].GetY());
+        path.emplace_back(nodes[currentNodeIndex].GetX());
+
+        if (currentNodeIndex == fromNode) break;
+
+        const AstarNode& currentNode = nodes[currentNodeIndex];
+        int best = -1;
+        float bestScore = INFINITE;
+
+        for (int i = currentNode.GetEdgeIndex(); i < currentNode.GetEdgeIndex() + currentNode.GetNumEdges(); ++i) {
+            const int next = edges[i].GetNodeIdB();
+
+            if (g[next] == INFINITE || g[next] != rhs[next]) continue;
+
+            const float score = g[next] + edges[i].GetDist();
+            if (score < bestScore) {
+                best = next;
+                bestScore = score;
+            }
+        }
+
+        if (best == -1) {
+            path.clear();
+            return path;
+        }
+
+        currentNodeIndex = best;
+    }
+
+    if (currentNodeIndex != fromNode) {
+        path.clear();
+        return path;
+    }
+
+    path.emplace_back(fromY);
+    path.emplace_back(fromX);
+
+    std::reverse(path.begin(), path.end());
+
+    return path;
+}
+
+
+void IncrementalSearch::Reset(const Quadtree& quadtree, const AstarGraph& graph, int fromNode, int toNode) {
+    const int numNodes = graph.GetNodes().size();
+
+    this->quadtree = &quadtree;
+    this->graph = &graph;
+    this->version = quadtree.GetVersion();
+    this->fromNode = fromNode;
+    this->toNode = toNode;
+    this->fromKey = LeafKey(quadtree.GetLeafs()[fromNode]);
+    this->toKey = LeafKey(quadtree.GetLeafs()[toNode]);
+
+    g.assign(numNodes, INFINITE);
+    rhs.assign(numNodes, INFINITE);
+    isTouched.assign(numNodes, 0);
+    touched.clear();
+    touchedKeys.clear();
+    openSet = decltype(openSet)();
+
+    this->Touch(fromNode);
+    rhs[fromNode] = 0;
+    openSet.push(this->CalculateKey(fromNode));
+}
+
+
+void IncrementalSearch::Remap(const Quadtree& quadtree, const AstarGraph& graph) {
+    const std::vector<Quadrant>& leafs = quadtree.GetLeafs();
+    const std::vector<AstarNode>& nodes = graph.GetNodes();
+    const std::vector<AstarEdge>& edges = graph.GetEdges();
+
+    struct Carried {
+        LeafKey key;
+        float g;
+        float rhs;
+    };
+
+    std::vector<Carried> carried;
+    carried.reserve(touched.size());
+
+    // Take the touched values out, which leaves every entry infinite
+    for (int i = 0; i < touched.size(); ++i) {
+        const int node = touched[i];
+        carried.push_back(Carried{touchedKeys[i], g[node], rhs[node]});
+
+        g[node] = INFINITE;
+        rhs[node] = INFINITE;
+        isTouched[node] = 0;
+    }
+
+    touched.clear();
+    touchedKeys.clear();
+
+    g.resize(nodes.size(), INFINITE);
+    rhs.resize(nodes.size(), INFINITE);
+    isTouched.resize(nodes.size(), 0);
+
+    this->quadtree = &quadtree;
+    this->graph = &graph;
+    this->version = quadtree.GetVersion();
+
+    // A vertex survives when a valid leaf with the same code, level and class is still there
+    for (const Carried& vertex : carried) {
+        const int node = quadtree.FindLeaf(vertex.key);
+
+        if (node == -1 || !leafs[node].IsValid()) continue;
+
+        this->Touch(node);
+        g[node] = vertex.g;
+        rhs[node] = vertex.rhs;
+    }
+
+    fromNode = quadtree.FindLeaf(fromKey);
+    toNode = quadtree.FindLeaf(toKey);
+
+    // Only vertices next to a finite g can have a finite rhs, so re-evaluating the
+    // survivors and their neighbours covers every edge that changed.
+    // Queue entries refer to the old indices and are rebuilt on the way.
+    openSet = decltype(openSet)();
+
+    const std::vector<int> survivors = touched;
+
+    for (int node : survivors) {
+        this->UpdateVertex(node);
+
+        for (int e = nodes[node].GetEdgeIndex(); e < nodes[node].GetEdgeIndex() + nodes[node].GetNumEdges(); ++e) {
+            const int next = edges[e].GetNodeIdB();
+
+            if (!isTouched[next]) {
+                this->UpdateVertex(next);
+            }
+        }
+    }
+}
+
+
+void IncrementalSearch::Touch(int node) {
+    if (!isTouched[node]) {
+        isTouched[node] = 1;
+        touched.push_back(node);
+        touchedKeys.emplace_back(quadtree->GetLeafs()[node]);
+    }
+}
+
+
+IncrementalSearch::QueueEntry IncrementalSearch::CalculateKey(int node) const {
+    const std::vector<AstarNode>& nodes = graph->GetNodes();
+
+    const float dX = nodes[node].GetX() - nodes[toNode].GetX();
+    const float dY = nodes[node].GetY() - nodes[toNode].GetY();
+    const float best = std::min(g[node], rhs[node]);
+
+    if (best == INFINITE) {
+        return QueueEntry{INFINITE, INFINITE, node};
+    }
+
+    return QueueEntry{best + std::sqrt(dX * dX + dY * dY), best, node};
+}
+
+
+void IncrementalSearch::UpdateVertex(int node) {
+    this->Touch(node);
+
+    if (node != fromNode) {
+        const std::vector<AstarNode>& nodes = graph->GetNodes();
+        const std::vector<AstarEdge>& edges = graph->GetEdges();
+
+        float best = INFINITE;
+
+        for (int i = nodes[node].GetEdgeIndex(); i < nodes[node].GetEdgeIndex() + nodes[node].GetNumEdges(); ++i) {
+            const int next = edges[i].GetNodeIdB();
+
+            if (g[next] != INFINITE) {
+                best = std::min(best, g[next] + edges[i].GetDist());
+            }
+        }
+
+        rhs[node] = best;
+    }
+
+    // Entries of vertices that became consistent are dropped when popped
+    if (g[node] != rhs[node]) {
+        openSet.push(this->CalculateKey(node));
+    }
+}
+
+
+void IncrementalSearch::ComputeShortestPath() {
+    const std::vector<AstarNode>& nodes = graph->GetNodes();
+    const std::vector<AstarEdge>& edges = graph->GetEdges();
+
+    while (openSet.size() > 0) {
+        const QueueEntry top = openSet.top();
+
+        // Skip consistent vertices and requeue outdated keys
+        if (g[top.node] == rhs[top.node]) {
+            openSet.pop();
+            continue;
+        }
+
+        const QueueEntry key = this->CalculateKey(top.node);
+
+        if (key > top) {
+            openSet.pop();
+            openSet.push(key);
+            continue;
+        }
+
+        const QueueEntry goalKey = this->CalculateKey(toNode);
+
+        if (!(goalKey > top) && rhs[toNode] == g[toNode]) {
+            break;
+        }
+
+        openSet.pop();
+        numExpanded++;
+
+        const int node = top.node;
+
+        if (g[node] > rhs[node]) {
+            g[node] = rhs[node];
+        } else {
+            g[node] = INFINITE;
+            this->UpdateVertex(node);
+        }
+
+        for (int i = nodes[node].GetEdgeIndex(); i < nodes[node].GetEdgeIndex() + nodes[node].GetNumEdges(); ++i) {
+            this->UpdateVertex(edges[i].GetNodeIdB());
+        }
+    }
+}
+
+
+void IncrementalSearch::Clear() {
+    quadtree = nullptr;
+    graph = nullptr;
+    version = 0;
+    fromNode = -1;
+    toNode = -1;
+    g.clear();
+    rhs.clear();
+    touched.clear();
+    touchedKeys.clear();
+    isTouched.clear();
+    openSet = decltype(openSet)();
+}
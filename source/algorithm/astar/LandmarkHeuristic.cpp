@@ -0,0 +1,237 @@
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <random>
+#include <vector>
+
+#include "AstarGraph.hpp"
+#include "LandmarkHeuristic.hpp"
+#include "Parallel.hpp"
+
+
+namespace {
+    constexpr float INFINITE = std::numeric_limits<float>::max();
+
+    struct QueueEntry {
+        float key;
+        int node;
+
+        bool operator>(const QueueEntry& other) const {
+            return key > other.key;
+        }
+    };
+
+    // Multi source Dijkstra, unreachable nodes keep INFINITE
+    void Dijkstra(
+        const AstarGraph& graph,
+        const std::vector<int>& sources,
+        std::vector<float>& distances,
+        std::vector<int>* parent,
+        std::vector<int>* order
+    ) {
+        const std::vector<AstarNode>& nodes = graph.GetNodes();
+        const std::vector<AstarEdge>& edges = graph.GetEdges();
+
+        distances.assign(nodes.size(), INFINITE);
+        if (parent != nullptr) parent->assign(nodes.size(), -1);
+        if (order != nullptr) order->clear();
+
+        std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>> queue;
+
+        for (int source : sources) {
+            distances[source] = 0;
+            queue.push(QueueEntry{0, source});
+        }
+
+        while (queue.size() > 0) {
+            const QueueEntry current = queue.top();
+            queue.pop();
+
+            if (current.key > distances[current.node]) continue;
+
+            if (order != nullptr) order->push_back(current.node);
+
+            const AstarNode& node = nodes[current.node];
+
+            for (int i = node.GetEdgeIndex(); i < node.GetEdgeIndex() + node.GetNumEdges(); ++i) {
+                const int next = edges[i].GetNodeIdB();
+                const float distance = current.key + edges[i].GetDist();
+
+                if (distance < distances[next]) {
+                    distances[next] = distance;
+                    if (parent != nullptr) (*parent)[next] = current.node;
+                    queue.push(QueueEntry{distance, next});
+                }
+            }
+        }
+    }
+}
+
+
+void LandmarkHeuristic::Build(const AstarGraph& graph, int numLandmarks, LandmarkStrategy strategy) {
+    this->Clear();
+
+    const int numNodes = graph.GetNodes().size();
+
+    if (strategy == LandmarkStrategy::AVOID) {
+        this->SelectAvoid(graph, numLandmarks);
+    } else {
+        this->SelectFarthest(graph, numLandmarks);
+    }
+
+    stride = (landmarks.size() + 3) & ~3;
+    distances.assign((size_t)numNodes * stride, 0);
+
+    // One Dijkstra per landmark, each thread owns a column of the table
+    Parallel::For(landmarks.size(), [&](int l) {
+        std::vector<float> landmarkDistances;
+        Dijkstra(graph, {landmarks[l]}, landmarkDistances, nullptr, nullptr);
+
+        for (int i = 0; i < numNodes; ++i) {
+            if (landmarkDistances[i] != INFINITE) {
+                distances[(size_t)i * stride + l] = landmarkDistances[i];
+            }
+        }
+    });
+}
+
+
+void LandmarkHeuristic::SelectFarthest(const AstarGraph& graph, int numLandmarks) {
+    const std::vector<AstarNode>& nodes = graph.GetNodes();
+
+    // Start in the largest component, landmarks elsewhere would bound nothing
+    const std::vector<AstarEdge>& edges = graph.GetEdges();
+    std::vector<char> seen(nodes.size());
+    std::vector<int> stack;
+    int start = -1;
+    int startSize = 0;
+
+    for (int i = 0; i < nodes.size(); ++i) {
+        if (seen[i] || nodes[i].GetNumEdges() == 0) continue;
+
+        int size = 0;
+        seen[i] = 1;
+        stack.push_back(i);
+
+        while (stack.size() > 0) {
+            const AstarNode& node = nodes[stack.back()];
+            stack.pop_back();
+            size++;
+
+            for (int e = node.GetEdgeIndex(); e < node.GetEdgeIndex() + node.GetNumEdges(); ++e) {
+                const int next = edges[e].GetNodeIdB();
+                if (seen[next]) continue;
+                seen[next] = 1;
+                stack.push_back(next);
+            }
+        }
+
+        if (size > startSize) {
+            start = i;
+            startSize = size;
+        }
+    }
+
+    if (start == -1) return;
+
+    // The first landmark is the node farthest from an arbitrary start
+    std::vector<int> sources = {start};
+    std::vector<float> minDistances;
+
+    while (landmarks.size() < numLandmarks) {
+        Dijkstra(graph, sources, minDistances, nullptr, nullptr);
+
+        int farthest = -1;
+        for (int i = 0; i < nodes.size(); ++i) {
+            if (minDistances[i] == INFINITE || minDistances[i] == 0) continue;
+            if (farthest == -1 || minDistances[i] > minDistances[farthest]) farthest = i;
+        }
+
+        if (farthest == -1) break;
+
+        landmarks.push_back(farthest);
+        sources = landmarks;
+    }
+}
+
+
+void LandmarkHeuristic::SelectAvoid(const AstarGraph& graph, int numLandmarks) {
+    const std::vector<AstarNode>& nodes = graph.GetNodes();
+    const int numNodes = nodes.size();
+
+    std::vector<int> candidates;
+    for (int i = 0; i < numNodes; ++i) {
+        if (nodes[i].GetNumEdges() > 0) candidates.push_back(i);
+    }
+
+    if (candidates.size() == 0) return;
+
+    std::mt19937 random(numNodes);
+
+    std::vector<std::vector<float>> landmarkDistances;
+    std::vector<float> rootDistances;
+    std::vector<int> parent;
+    std::vector<int> order;
+    std::vector<float> size(numNodes);
+    std::vector<char> hasLandmark(numNodes);
+    std::vector<int> bestChild(numNodes);
+
+    for (int k = 0; k < numLandmarks; ++k) {
+        const int root = candidates[random() % candidates.size()];
+        Dijkstra(graph, {root}, rootDistances, &parent, &order);
+
+        // Weight is how much the current landmarks underestimate the distance from the root
+        for (int node : order) {
+            float bound = 0;
+            for (const std::vector<float>& landmark : landmarkDistances) {
+                if (landmark[root] == INFINITE || landmark[node] == INFINITE) continue;
+                bound = std::max(bound, std::abs(landmark[node] - landmark[root]));
+            }
+
+            size[node] = rootDistances[node] - bound;
+            hasLandmark[node] = std::find(landmarks.begin(), landmarks.end(), node) != landmarks.end();
+            bestChild[node] = -1;
+        }
+
+        // Subtree sizes bottom up, subtrees holding a landmark do not count
+        for (int i = order.size() - 1; i > 0; --i) {
+            const int node = order[i];
+            const int up = parent[node];
+
+            if (hasLandmark[node]) {
+                hasLandmark[up] = 1;
+                continue;
+            }
+
+            size[up] += size[node];
+
+            if (bestChild[up] == -1 || size[node] > size[bestChild[up]]) {
+                bestChild[up] = node;
+            }
+        }
+
+        for (int node : order) {
+            if (hasLandmark[node]) size[node] = 0;
+        }
+
+        int node = root;
+        while (bestChild[node] != -1 && size[bestChild[node]] > 0) {
+            node = bestChild[node];
+        }
+
+        if (node == root && std::find(landmarks.begin(), landmarks.end(), node) != landmarks.end()) continue;
+
+        landmarks.push_back(node);
+        landmarkDistances.emplace_back();
+        Dijkstra(graph, {node}, landmarkDistances.back(), nullptr, nullptr);
+    }
+}
+
+
+void LandmarkHeuristic::Clear() {
+    landmarks.clear();
+    distances.clear();
+    stride = 0;
+}
@@ -0,0 +1,183 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <vector>
+
+#include "ankerl/unordered_dense.h"
+
+#include "LazyQuadtree.hpp"
+#include "LazySearch.hpp"
+#include "Quadtree.hpp"
+
+
+namespace {
+    struct LazyEntry {
+        float fScore;
+        float gScore;
+        int node;
+
+        bool operator>(const LazyEntry& other) const {
+            return fScore > other.fScore;
+        }
+    };
+
+    uint64_t MakeKey(const Quadrant& leaf) {
+        return (leaf.GetCode() << 5) | leaf.GetLevel();
+    }
+}
+
+
+void LazySearch::SetTerrainCosts(const std::vector<float>& terrainCosts) {
+    this->terrainCosts.resize(terrainCosts.size());
+
+    for (int i = 0; i < terrainCosts.size(); ++i) {
+        this->terrainCosts[i] = std::max(1.0f, terrainCosts[i]);
+    }
+}
+
+
+// Returns a list of x y coords
+std::vector<int> LazySearch::GetPath(LazyQuadtree& quadtree, int fromX, int fromY, int toX, int toY) {
+    std::vector<int> path; // xyxyxy...
+
+    numExpanded = 0;
+
+    Quadrant fromLeaf(0, 0, 0);
+    Quadrant toLeaf(0, 0, 0);
+
+    if (!quadtree.FindLeaf(fromX, fromY, fromLeaf) || !quadtree.FindLeaf(toX, toY, toLeaf)) {
+        quadtree.Trim();
+        return path;
+    }
+
+    // They are in the same region.
+    if (MakeKey(fromLeaf) == MakeKey(toLeaf)) {
+        quadtree.Trim();
+        path.emplace_back(fromX);
+        path.emplace_back(fromY);
+        path.emplace_back(toX);
+        path.emplace_back(toY);
+        return path;
+    }
+
+    const int resolution = quadtree.GetResolution();
+
+    // Nodes are numbered as the search discovers their leafs
+    ankerl::unordered_dense::map<uint64_t, int> nodeIndex;
+    std::vector<Quadrant> leafs;
+    std::vector<int> centers; // xyxyxy...
+    std::vector<float> gScores;
+    std::vector<int> parents;
+    std::vector<bool> closeSet;
+
+    auto addNode = [&](const Quadrant& leaf) -> int {
+        const auto [iterator, isNew] = nodeIndex.try_emplace(MakeKey(leaf), (int)leafs.size());
+
+        if (isNew) {
+            const int halfLength = (1 << (resolution - leaf.GetLevel())) / 2;
+            leafs.emplace_back(leaf);
+            centers.emplace_back(leaf.GetX() + halfLength);
+            centers.emplace_back(leaf.GetY() + halfLength);
+            gScores.emplace_back(std::numeric_limits<float>::max());
+            parents.emplace_back(-1);
+            closeSet.emplace_back(false);
+        }
+
+        return iterator->second;
+    };
+
+    const int fromNode = addNode(fromLeaf);
+    const int toNode = addNode(toLeaf);
+
+    const float goalX = centers[2 * toNode];
+    const float goalY = centers[2 * toNode + 1];
+
+    auto estimate = [&](int node) -> float {
+        const float dX = centers[2 * node] - goalX;
+        const float dY = centers[2 * node + 1] - goalY;
+        return std::sqrt(dX * dX + dY * dY);
+    };
+
+    gScores[fromNode] = 0;
+
+    std::priority_queue<LazyEntry, std::vector<LazyEntry>, std::greater<LazyEntry>> openSet;
+    openSet.push(LazyEntry{estimate(fromNode), 0, fromNode});
+
+    bool isPathFound = false;
+
+    while (openSet.size() > 0) {
+        const LazyEntry current = openSet.top();
+        openSet.pop();
+
+        if (current.node == toNode) {
+            isPathFound = true;
+            break;
+        }
+
+        if (closeSet[current.node]) continue;
+        closeSet[current.node] = true;
+
+        numExpanded++;
+
+        // Materialises the blocks next to the leaf on first expansion
+        neighbors.clear();
+        quadtree.FindNeighbors(leafs[current.node], neighbors);
+
+        const Quadrant currentLeaf = leafs[current.node];
+        const float lengthA = 1 << (resolution - currentLeaf.GetLevel());
+        const float costA = this->GetTerrainCost(currentLeaf.GetTerrain());
+
+        for (const Quadrant& neighbor : neighbors) {
+            const int next = addNode(neighbor);
+
+            if (closeSet[next]) continue;
+
+            const float dX = centers[2 * next] - centers[2 * current.node];
+            const float dY = centers[2 * next + 1] - centers[2 * current.node + 1];
+            float dist = std::sqrt(dX * dX + dY * dY);
+
+            if (terrainCosts.size() > 0) {
+                const float lengthB = 1 << (resolution - neighbor.GetLevel());
+                const float costB = this->GetTerrainCost(neighbor.GetTerrain());
+                dist *= (lengthA * costA + lengthB * costB) / (lengthA + lengthB);
+            }
+
+            const float gScore = current.gScore + dist;
+
+            if (gScore >= gScores[next]) continue;
+
+            gScores[next] = gScore;
+            parents[next] = current.node;
+            openSet.push(LazyEntry{gScore + estimate(next), gScore, next});
+        }
+    }
+
+    quadtree.Trim();
+
+    // Reconstruct path
+    if (isPathFound) {
+        int depth = 0;
+        for (int node = toNode; node != -1; node = parents[node]) {
+            depth++;
+        }
+
+        path.resize(2 * depth + 4);
+        path[0] = fromX;
+        path[1] = fromY;
+
+        int i = depth;
+        for (int node = toNode; node != -1; node = parents[node]) {
+            path[2 * i] = centers[2 * node];
+            path[2 * i + 1] = centers[2 * node + 1];
+            i--;
+        }
+
+        path[2 * depth + 2] = toX;
+        path[2 * depth + 3] = toY;
+    }
+
+    return path;
+}
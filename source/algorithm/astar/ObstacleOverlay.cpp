@@ -0,0 +1,100 @@
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "ObstacleOverlay.hpp"
+#include "Quadtree.hpp"
+
+
+void ObstacleOverlay::Reset(const Quadtree& quadtree) {
+    version = quadtree.GetVersion();
+    numLeafs = quadtree.GetLeafs().size();
+
+    blocked.assign((numLeafs + 63) / 64, 0);
+    costs.clear();
+}
+
+
+void ObstacleOverlay::Clear() {
+    std::fill(blocked.begin(), blocked.end(), 0);
+    costs.clear();
+}
+
+
+void ObstacleOverlay::BlockPoint(const Quadtree& quadtree, int x, int y) {
+    const int leaf = quadtree.QueryValidRegion((uint32_t)x, (uint32_t)y);
+
+    if (leaf != -1) {
+        this->BlockLeaf(leaf);
+    }
+}
+
+
+void ObstacleOverlay::BlockRect(const Quadtree& quadtree, int x, int y, int width, int height) {
+    this->ForEachLeaf(quadtree, x, y, width, height, [&](int leaf) {
+        this->BlockLeaf(leaf);
+    });
+}
+
+
+void ObstacleOverlay::AddCost(int leaf, float cost) {
+    if (cost <= 0 || leaf < 0 || leaf >= numLeafs) return;
+
+    costs[leaf] += cost;
+}
+
+
+void ObstacleOverlay::AddCostPoint(const Quadtree& quadtree, int x, int y, float cost) {
+    const int leaf = quadtree.QueryValidRegion((uint32_t)x, (uint32_t)y);
+
+    if (leaf != -1) {
+        this->AddCost(leaf, cost);
+    }
+}
+
+
+void ObstacleOverlay::AddCostRect(const Quadtree& quadtree, int x, int y, int width, int height, float cost) {
+    this->ForEachLeaf(quadtree, x, y, width, height, [&](int leaf) {
+        this->AddCost(leaf, cost);
+    });
+}
+
+
+void ObstacleOverlay::ForEachLeaf(
+    const Quadtree& quadtree, int x, int y, int width, int height,
+    const std::function<void(int)>& function
+) const {
+    const std::vector<Quadrant>& leafs = quadtree.GetLeafs();
+    const int resolution = quadtree.GetResolution();
+    const int side = 1 << resolution;
+
+    const int fromX = std::max(x, 0);
+    const int fromY = std::max(y, 0);
+    const int toX = std::min(x + width, side);
+    const int toY = std::min(y + height, side);
+
+    // A leaf is visited on every row it spans, only the row of its top edge
+    // or the first row of the rectangle reports it
+    for (int row = fromY; row < toY; ++row) {
+        int column = fromX;
+
+        while (column < toX) {
+            const int leaf = quadtree.QueryRegion((uint32_t)column, (uint32_t)row);
+
+            if (leaf == -1) {
+                column++;
+                continue;
+            }
+
+            const Quadrant& quad = leafs[leaf];
+            const int length = 1 << (resolution - quad.GetLevel());
+
+            if (quad.IsValid() && (quad.GetY() == row || row == fromY)) {
+                function(leaf);
+            }
+
+            column = quad.GetX() + length;
+        }
+    }
+}
@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "PathCache.hpp"
+#include "Quadtree.hpp"
+
+
+PathCache::PathCache(size_t memoryBudget) {
+    this->memoryBudget = memoryBudget;
+    this->memoryUsage = 0;
+    this->numHits = 0;
+    this->numMisses = 0;
+    this->version = 0;
+    this->nextEntry = 0;
+}
+
+
+bool PathCache::Lookup(const Quadtree& quadtree, int fromLeaf, int toLeaf, std::vector<int>& leafPath) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (quadtree.GetVersion() != version) {
+        this->DropStale(quadtree);
+    }
+
+    const std::vector<Quadrant>& leafs = quadtree.GetLeafs();
+
+    const auto fromIterator = occurrences.find(LeafKey(leafs[fromLeaf]));
+    const auto toIterator = occurrences.find(LeafKey(leafs[toLeaf]));
+
+    if (fromIterator != occurrences.end() && toIterator != occurrences.end()) {
+        for (const Occurrence& from : fromIterator->second) {
+            for (const Occurrence& to : toIterator->second) {
+                if (from.entry != to.entry) continue;
+
+                CacheEntry& entry = entries.find(from.entry)->second;
+                lru.splice(lru.begin(), lru, entry.lruIterator);
+
+                // The graph is undirected, so the path also serves the reverse query
+                const int step = from.position <= to.position ? 1 : -1;
+
+                leafPath.clear();
+                for (int i = from.position; i != to.position + step; i += step) {
+                    leafPath.push_back(quadtree.FindLeaf(entry.leafs[i]));
+                }
+
+                numHits++;
+                return true;
+            }
+        }
+    }
+
+    numMisses++;
+    return false;
+}
+
+
+void PathCache::Insert(const Quadtree& quadtree, const std::vector<int>& leafPath) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (quadtree.GetVersion() != version) {
+        this->DropStale(quadtree);
+    }
+
+    const size_t memory = sizeof(CacheEntry) + leafPath.size() * (sizeof(LeafKey) + sizeof(Occurrence));
+
+    if (leafPath.size() < 2 || memory > memoryBudget) {
+        return;
+    }
+
+    const std::vector<Quadrant>& leafs = quadtree.GetLeafs();
+    const int id = nextEntry++;
+
+    lru.push_front(id);
+    CacheEntry& entry = entries.emplace(id, CacheEntry{{}, lru.begin(), memory}).first->second;
+
+    entry.leafs.reserve(leafPath.size());
+
+    for (int i = 0; i < leafPath.size(); ++i) {
+        const LeafKey key(leafs[leafPath[i]]);
+        entry.leafs.push_back(key);
+        occurrences[key].push_back(Occurrence{id, i});
+    }
+
+    memoryUsage += memory;
+
+    this->Evict();
+}
+
+
+void PathCache::Revalidate(const Quadtree& quadtree) {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->DropStale(quadtree);
+}
+
+
+void PathCache::DropStale(const Quadtree& quadtree) {
+    std::vector<int> stale;
+
+    for (const auto& [id, entry] : entries) {
+        for (const LeafKey& key : entry.leafs) {
+            const int leaf = quadtree.FindLeaf(key);
+
+            if (leaf == -1 || !quadtree.GetLeafs()[leaf].IsValid()) {
+                stale.push_back(id);
+                break;
+            }
+        }
+    }
+
+    for (int id : stale) {
+        this->Erase(id);
+    }
+
+    version = quadtree.GetVersion();
+}
+
+
+void PathCache::Clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    lru.clear();
+    entries.clear();
+    occurrences.clear();
+    memoryUsage = 0;
+    numHits = 0;
+    numMisses = 0;
+}
+
+
+void PathCache::Erase(int id) {
+    auto iterator = entries.find(id);
+    const CacheEntry& entry = iterator->second;
+
+    for (const LeafKey& key : entry.leafs) {
+        auto occurrence = occurrences.find(key);
+
+        if (occurrence == occurrences.end()) continue;
+
+        std::vector<Occurrence>& list = occurrence->second;
+        list.erase(std::remove_if(list.begin(), list.end(), [id](const Occurrence& o) {
+            return o.entry == id;
+        }), list.end());
+
+        if (list.size() == 0) {
+            occurrences.erase(occurrence);
+        }
+    }
+
+    memoryUsage -= entry.memory;
+    lru.erase(entry.lruIterator);
+    entries.erase(iterator);
+}
+
+
+void PathCache::Evict() {
+    while (memoryUsage > memoryBudget && lru.size() > 0) {
+        this->Erase(lru.back());
+    }
+}
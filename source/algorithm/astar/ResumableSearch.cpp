@@ -0,0 +1,316 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "ArcFlags.hpp"
+#include "AstarGraph.hpp"
+#include "ClearanceMap.hpp"
+#include "LandmarkHeuristic.hpp"
+#include "ObstacleOverlay.hpp"
+#include "Quadtree.hpp"
+#include "ResumableSearch.hpp"
+
+
+bool ResumableSearch::Start(
+    const Quadtree& quadtree, const AstarGraph& graph,
+    int fromX, int fromY, int toX, int toY, float agentRadius
+) {
+    this->quadtree = &quadtree;
+    this->graph = &graph;
+    this->fromX = fromX;
+    this->fromY = fromY;
+    this->toX = toX;
+    this->toY = toY;
+
+    numExpanded = 0;
+    openSet = decltype(openSet)();
+
+    fromNode = quadtree.QueryValidRegion((uint32_t)fromX, (uint32_t)fromY);
+    toNode = quadtree.QueryValidRegion((uint32_t)toX, (uint32_t)toY);
+
+    // An overlay sized for another tree would mark the wrong leafs
+    if (fromNode == -1 || toNode == -1 || (overlay != nullptr && !overlay->IsCurrent(quadtree))) {
+        status = SEARCH_NOT_FOUND;
+        return false;
+    }
+
+    this->agentRadius = clearance != nullptr ? std::max(0.0f, agentRadius) : 0.0f;
+
+    if (overlay != nullptr && fromNode != toNode && overlay->IsBlocked(toNode)) {
+        status = SEARCH_NOT_FOUND;
+        return false;
+    }
+
+    // The agent does not fit where it starts or ends
+    if (this->agentRadius > 0 && (clearance->GetLeafClearance(fromNode) < this->agentRadius
+            || clearance->GetLeafClearance(toNode) < this->agentRadius)) {
+        status = SEARCH_NOT_FOUND;
+        return false;
+    }
+
+    // Arc flags only hold for a point agent on the graph without an overlay
+    goalMask = arcFlags != nullptr && overlay == nullptr && this->agentRadius == 0 ? arcFlags->GetRegionMask(toNode) : ~(uint64_t)0;
+
+    const int numNodes = graph.GetNodes().size();
+
+    if (++stamp == 0 || visited.size() != numNodes) {
+        gScores.resize(numNodes);
+        parents.resize(numNodes);
+        visited.assign(numNodes, 0);
+        closed.assign(numNodes, 0);
+        stamp = 1;
+    }
+
+    visited[fromNode] = stamp;
+    gScores[fromNode] = 0;
+    parents[fromNode] = -1;
+
+    bestNode = fromNode;
+    bestEstimate = this->Estimate(fromNode);
+
+    openSet.push(QueueEntry{bestEstimate, fromNode});
+
+    status = fromNode == toNode ? SEARCH_FOUND : SEARCH_RUNNING;
+    return true;
+}
+
+
+SearchStatus ResumableSearch::Step(int maxExpansions) {
+    for (int i = 0; i < maxExpansions && this->Expand(); ++i) {}
+
+    return status;
+}
+
+
+SearchStatus ResumableSearch::Step(Clock::time_point deadline) {
+    // Reading the clock costs about as much as a few expansions, check it in batches
+    constexpr int CHECK_INTERVAL = 32;
+
+    while (status == SEARCH_RUNNING && Clock::now() < deadline) {
+        this->Step(CHECK_INTERVAL);
+    }
+
+    return status;
+}
+
+
+void ResumableSearch::Cancel() {
+    if (status == SEARCH_RUNNING) {
+        status = SEARCH_CANCELLED;
+        openSet = decltype(openSet)();
+    }
+}
+
+
+float ResumableSearch::Estimate(int node) const {
+    const AstarNode& astarNode = graph->GetNodes()[node];
+    const float dX = astarNode.GetX() - toX;
+    const float dY = astarNode.GetY() - toY;
+    const float estimate = std::sqrt(dX * dX + dY * dY);
+
+    if (landmarks != nullptr) {
+        return std::max(estimate, landmarks->Estimate(node, toNode));
+    }
+
+    return estimate;
+}
+
+
+bool ResumableSearch::Expand() {
+    if (status != SEARCH_RUNNING) {
+        return false;
+    }
+
+    const std::vector<AstarNode>& nodes = graph->GetNodes();
+    const std::vector<AstarEdge>& edges = graph->GetEdges();
+
+    // Skip entries left behind by a later improvement
+    while (openSet.size() > 0 && closed[openSet.top().node] == stamp) {
+        openSet.pop();
+    }
+
+    if (openSet.size() == 0) {
+        status = SEARCH_NOT_FOUND;
+        return false;
+    }
+
+    const int currentNodeIndex = openSet.top().node;
+    openSet.pop();
+
+    if (currentNodeIndex == toNode) {
+        status = SEARCH_FOUND;
+        openSet = decltype(openSet)();
+        return false;
+    }
+
+    closed[currentNodeIndex] = stamp;
+    numExpanded++;
+
+    const float estimate = this->Estimate(currentNodeIndex);
+    if (estimate < bestEstimate) {
+        bestNode = currentNodeIndex;
+        bestEstimate = estimate;
+    }
+
+    const AstarNode& currentNode = nodes[currentNodeIndex];
+
+    for (int i = currentNode.GetEdgeIndex(); i < currentNode.GetEdgeIndex() + currentNode.GetNumEdges(); ++i) {
+        if (arcFlags != nullptr && (arcFlags->GetFlags(i) & goalMask) == 0) {
+            continue;
+        }
+
+        if (agentRadius > 0 && clearance->GetEdgeClearance(i) < agentRadius) {
+            continue;
+        }
+
+        const int nextNodeIndex = edges[i].GetNodeIdB();
+
+        if (closed[nextNodeIndex] == stamp) {
+            continue;
+        }
+
+        if (overlay != nullptr && overlay->IsBlocked(nextNodeIndex)) {
+            continue;
+        }
+
+        const float gScore = gScores[currentNodeIndex] + edges[i].GetDist() + (overlay != nullptr ? overlay->GetCost(nextNodeIndex) : 0);
+
+        if (visited[nextNodeIndex] != stamp || gScore < gScores[nextNodeIndex]) {
+            visited[nextNodeIndex] = stamp;
+            gScores[nextNodeIndex] = gScore;
+            parents[nextNodeIndex] = currentNodeIndex;
+            openSet.push(QueueEntry{gScore + this->Estimate(nextNodeIndex), nextNodeIndex});
+        }
+    }
+
+    return true;
+}
+
+
+// Returns a list of x y coords
+std::vector<int> ResumableSearch::GetPath() const {
+    std::vector<int> path; // xyxyxy...
+
+    if (status == SEARCH_FOUND && fromNode == toNode) {
+        path.emplace_back(fromX);
+        path.emplace_back(fromY);
+        path.emplace_back(toX);
+        path.emplace_back(toY);
+        return path;
+    }
+
+    const bool isFound = status == SEARCH_FOUND;
+
+    if (!isFound && status != SEARCH_RUNNING) {
+        return path;
+    }
+
+    const std::vector<AstarNode>& nodes = graph->GetNodes();
+
+    if (isFound) {
+        path.emplace_back(toY);
+        path.emplace_back(toX);
+    }
+
+    int currentNodeIndex = isFound ? toNode : bestNode;
+
+    do {
+        path.emplace_back(nodes[currentNodeIndex].GetY());
+        path.emplace_back(nodes[currentNodeIndex].GetX());
+        currentNodeIndex = parents[currentNodeIndex];
+    } while (currentNodeIndex != -1);
+
+    path.emplace_back(fromY);
+    path.emplace_back(fromX);
+
+    std::reverse(path.begin(), path.end());
+
+    return path;
+}
+
+
+int SearchScheduler::Submit(
+    const Quadtree& quadtree, const AstarGraph& graph,
+    int fromX, int fromY, int toX, int toY, float agentRadius
+) {
+    int id;
+
+    if (freeIds.size() > 0) {
+        id = freeIds.back();
+        freeIds.pop_back();
+    } else {
+        id = searches.size();
+        searches.emplace_back(std::make_unique<ResumableSearch>());
+        isLive.emplace_back(false);
+    }
+
+    ResumableSearch& search = *searches[id];
+    search.SetLandmarks(landmarks);
+    search.SetArcFlags(arcFlags);
+    search.SetOverlay(overlay);
+    search.SetClearance(clearance);
+
+    if (!search.Start(quadtree, graph, fromX, fromY, toX, toY, agentRadius)) {
+        freeIds.push_back(id);
+        return -1;
+    }
+
+    isLive[id] = true;
+    return id;
+}
+
+
+void SearchScheduler::Update(ResumableSearch::Clock::time_point deadline) {
+    int numRunning = this->GetNumRunning();
+
+    while (numRunning > 0 && ResumableSearch::Clock::now() < deadline) {
+        // Round robin from where the last frame stopped, so no search starves
+        next = next < searches.size() ? next : 0;
+
+        ResumableSearch& search = *searches[next];
+        next++;
+
+        if (!search.IsRunning()) continue;
+
+        if (search.Step(SLICE_EXPANSIONS) != SEARCH_RUNNING) {
+            numRunning--;
+        }
+    }
+}
+
+
+void SearchScheduler::Cancel(int id) {
+    searches[id]->Cancel();
+}
+
+
+void SearchScheduler::Release(int id) {
+    // A second release would hand the slot to two searches
+    if (id < 0 || id >= searches.size() || !isLive[id]) return;
+
+    searches[id]->Cancel();
+    isLive[id] = false;
+    freeIds.push_back(id);
+}
+
+
+void SearchScheduler::CancelAll() {
+    for (std::unique_ptr<ResumableSearch>& search : searches) {
+        search->Cancel();
+    }
+}
+
+
+int SearchScheduler::GetNumRunning() const {
+    int numRunning = 0;
+
+    for (const std::unique_ptr<ResumableSearch>& search : searches) {
+        numRunning += search->IsRunning();
+    }
+
+    return numRunning;
+}
@@ -0,0 +1,286 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <queue>
+#include <vector>
+
+#include "ankerl/unordered_dense.h"
+
+#include "ForestSearch.hpp"
+#include "QuadtreeForest.hpp"
+
+
+namespace {
+    // Tile local node, valid while the tile keeps the version it had when
+    // the node was reached
+    struct ForestKey {
+        int tileIndex;
+        int node;
+        uint32_t version;
+
+        bool operator==(const ForestKey& other) const {
+            return tileIndex == other.tileIndex && node == other.node && version == other.version;
+        }
+    };
+
+    struct ForestKeyHash {
+        using is_avalanching = void;
+
+        uint64_t operator()(const ForestKey& key) const {
+            return ankerl::unordered_dense::detail::wyhash::hash(&key, sizeof(ForestKey));
+        }
+    };
+
+    struct ForestEntry {
+        float fScore;
+        float gScore;
+        ForestKey key;
+
+        bool operator>(const ForestEntry& other) const {
+            return fScore > other.fScore;
+        }
+    };
+
+    // World position of a reached node, kept so the path can be rebuilt
+    // without fetching its tile again
+    struct ForestParent {
+        ForestKey key;
+        int x, y;
+    };
+}
+
+
+// Returns a list of x y coords
+std::vector<int> ForestSearch::GetPath(TileProvider& tiles, int fromX, int fromY, int toX, int toY) {
+    std::vector<int> path; // xyxyxy...
+
+    numExpanded = 0;
+
+    const int tileSize = tiles.GetTileSize();
+    const int tilesX = tiles.GetTilesX();
+    const int tilesY = tiles.GetTilesY();
+
+    if (fromX < 0 || fromY < 0 || toX < 0 || toY < 0) {
+        return path;
+    }
+
+    tiles.Prefetch(fromX, fromY, toX, toY);
+
+    // Only the tile being expanded and its neighbours are held, so the
+    // provider can evict the rest of the explored area. A tile fetched
+    // again may be a rebuild, its version tells whether the keys still hold.
+    bool isFetchFailed = false;
+
+    auto getTile = [&](int tileX, int tileY) -> std::shared_ptr<const QuadtreeTile> {
+        if (tileX < 0 || tileY < 0 || tileX >= tilesX || tileY >= tilesY) return nullptr;
+
+        std::shared_ptr<const QuadtreeTile> tile = tiles.GetTile(tileX, tileY);
+        isFetchFailed |= tile == nullptr;
+        return tile;
+    };
+
+    const int fromTileIndex = (fromY / tileSize) * tilesX + fromX / tileSize;
+    const int toTileIndex = (toY / tileSize) * tilesX + toX / tileSize;
+
+    // Finds the goal in the current version of its tile, node -1 if it is not in a valid leaf
+    auto findGoal = [&](const QuadtreeTile& tile) -> ForestKey {
+        return ForestKey{toTileIndex, tile.GetQuadtree().QueryValidRegion(toX % tileSize, toY % tileSize), tile.GetVersion()};
+    };
+
+    ForestKey fromKey;
+    ForestKey toKey;
+    int fromCenterX, fromCenterY;
+
+    {
+        const std::shared_ptr<const QuadtreeTile> fromTile = getTile(fromX / tileSize, fromY / tileSize);
+        const std::shared_ptr<const QuadtreeTile> toTile = getTile(toX / tileSize, toY / tileSize);
+
+        if (fromTile == nullptr || toTile == nullptr) {
+            return path;
+        }
+
+        const int fromNode = fromTile->GetQuadtree().QueryValidRegion(fromX % tileSize, fromY % tileSize);
+        fromKey = ForestKey{fromTileIndex, fromNode, fromTile->GetVersion()};
+        toKey = findGoal(*toTile);
+
+        if (fromKey.node == -1 || toKey.node == -1) {
+            return path;
+        }
+
+        const AstarNode& fromAstarNode = fromTile->GetGraph().GetNodes()[fromKey.node];
+        fromCenterX = (fromX / tileSize) * tileSize + fromAstarNode.GetX();
+        fromCenterY = (fromY / tileSize) * tileSize + fromAstarNode.GetY();
+    }
+
+    // They are in the same region.
+    if (fromKey == toKey) {
+        path.emplace_back(fromX);
+        path.emplace_back(fromY);
+        path.emplace_back(toX);
+        path.emplace_back(toY);
+        return path;
+    }
+
+    ankerl::unordered_dense::map<ForestKey, float, ForestKeyHash> gScores;
+    ankerl::unordered_dense::map<ForestKey, ForestParent, ForestKeyHash> parent;
+    ankerl::unordered_dense::set<ForestKey, ForestKeyHash> closeSet;
+
+    std::priority_queue<ForestEntry, std::vector<ForestEntry>, std::greater<ForestEntry>> openSet;
+
+    gScores.emplace(fromKey, 0);
+    parent.emplace(fromKey, ForestParent{fromKey, fromCenterX, fromCenterY});
+    openSet.push(ForestEntry{0, 0, fromKey});
+
+    std::vector<TilePortal> portals;
+
+    const std::vector<float>& terrainCosts = tiles.GetTerrainCosts();
+
+    auto getTerrainCost = [&](int terrain) -> float {
+        return terrain < terrainCosts.size() ? terrainCosts[terrain] : 1.0f;
+    };
+
+    auto relax = [&](const ForestKey& nextKey, float gScore, int nextX, int nextY, const ForestKey& currentKey) {
+        if (closeSet.find(nextKey) != closeSet.end()) return;
+
+        auto gIterator = gScores.find(nextKey);
+        if (gIterator != gScores.end() && gIterator->second <= gScore) return;
+
+        gScores.insert_or_assign(nextKey, gScore);
+        parent.insert_or_assign(nextKey, ForestParent{currentKey, nextX, nextY});
+
+        const float dX = nextX - toX;
+        const float dY = nextY - toY;
+        openSet.push(ForestEntry{gScore + std::sqrt(dX * dX + dY * dY), gScore, nextKey});
+    };
+
+    bool isPathFound = false;
+
+    while (openSet.size() > 0) {
+        const ForestEntry current = openSet.top();
+        openSet.pop();
+
+        if (closeSet.find(current.key) != closeSet.end()) continue;
+
+        const int tileIndex = current.key.tileIndex;
+        const int node = current.key.node;
+        const int tileX = tileIndex % tilesX;
+        const int tileY = tileIndex / tilesX;
+
+        const std::shared_ptr<const QuadtreeTile> tile = getTile(tileX, tileY);
+
+        if (isFetchFailed) return path;
+
+        // Rebuilt since the node was reached, its number may name another leaf now
+        if (tile->GetVersion() != current.key.version) continue;
+
+        if (tileIndex == toTileIndex && toKey.version != tile->GetVersion()) {
+            toKey = findGoal(*tile);
+
+            if (toKey.node == -1) return path;
+        }
+
+        if (current.key == toKey) {
+            isPathFound = true;
+            break;
+        }
+
+        closeSet.emplace(current.key);
+
+        numExpanded++;
+
+        const std::vector<AstarNode>& nodes = tile->GetGraph().GetNodes();
+        const std::vector<AstarEdge>& edges = tile->GetGraph().GetEdges();
+        const AstarNode& currentNode = nodes[node];
+
+        const int originX = tileX * tileSize;
+        const int originY = tileY * tileSize;
+        const int currentX = originX + currentNode.GetX();
+        const int currentY = originY + currentNode.GetY();
+
+        for (int i = currentNode.GetEdgeIndex(); i < currentNode.GetEdgeIndex() + currentNode.GetNumEdges(); ++i) {
+            const AstarNode& nextNode = nodes[edges[i].GetNodeIdB()];
+            relax(
+                ForestKey{tileIndex, edges[i].GetNodeIdB(), current.key.version}, current.gScore + edges[i].GetDist(),
+                originX + nextNode.GetX(), originY + nextNode.GetY(), current.key
+            );
+        }
+
+        // Stitch with the neighbouring tiles through the border portals
+        const Quadrant& leaf = tile->GetQuadtree().GetLeafs()[node];
+        const int length = 1 << (tile->GetQuadtree().GetResolution() - leaf.GetLevel());
+        const int leafX = leaf.GetX();
+        const int leafY = leaf.GetY();
+
+        const bool touches[4] = {
+            leafY == 0, leafY + length == tileSize,
+            leafX == 0, leafX + length == tileSize
+        };
+        const int neighborX[4] = {tileX, tileX, tileX - 1, tileX + 1};
+        const int neighborY[4] = {tileY - 1, tileY + 1, tileY, tileY};
+
+        for (int side = 0; side < 4; ++side) {
+            if (!touches[side]) continue;
+
+            const std::shared_ptr<const QuadtreeTile> neighborTile = getTile(neighborX[side], neighborY[side]);
+
+            if (isFetchFailed) return path;
+            if (neighborTile == nullptr) continue;
+
+            portals.clear();
+            neighborTile->FindPortals(side ^ 1, side < 2 ? leafX : leafY, length, portals);
+
+            const std::vector<AstarNode>& neighborNodes = neighborTile->GetGraph().GetNodes();
+            const std::vector<Quadrant>& neighborLeafs = neighborTile->GetQuadtree().GetLeafs();
+            const int neighborIndex = neighborY[side] * tilesX + neighborX[side];
+
+            for (const TilePortal& portal : portals) {
+                const int nextX = neighborX[side] * tileSize + neighborNodes[portal.node].GetX();
+                const int nextY = neighborY[side] * tileSize + neighborNodes[portal.node].GetY();
+                const float dX = nextX - currentX;
+                const float dY = nextY - currentY;
+                float dist = std::sqrt(dX * dX + dY * dY);
+
+                // Weighted by the two side lengths as in AstarGraph::AddEdge
+                if (terrainCosts.size() > 0) {
+                    const float costA = getTerrainCost(leaf.GetTerrain());
+                    const float costB = getTerrainCost(neighborLeafs[portal.node].GetTerrain());
+                    dist *= (length * costA + portal.length * costB) / (float)(length + portal.length);
+                }
+
+                relax(
+                    ForestKey{neighborIndex, portal.node, neighborTile->GetVersion()}, current.gScore + dist,
+                    nextX, nextY, current.key
+                );
+            }
+        }
+    }
+
+    // Reconstruct path
+    if (isPathFound) {
+        std::vector<const ForestParent*> reached;
+        for (ForestKey key = toKey; ; ) {
+            const ForestParent& entry = parent.at(key);
+            reached.push_back(&entry);
+
+            if (key == fromKey) break;
+            key = entry.key;
+        }
+
+        path.reserve(reached.size() * 2 + 4);
+        path.emplace_back(fromX);
+        path.emplace_back(fromY);
+
+        for (int i = reached.size() - 1; i >= 0; --i) {
+            path.emplace_back(reached[i]->x);
+            path.emplace_back(reached[i]->y);
+        }
+
+        path.emplace_back(toX);
+        path.emplace_back(toY);
+    }
+
+    return path;
+}
@@ -0,0 +1,173 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "AstarGraph.hpp"
+#include "GridEnvironment.hpp"
+#include "Parallel.hpp"
+#include "Quadtree.hpp"
+#include "QuadtreeForest.hpp"
+
+
+const bool TileGridEnvironment::IsValid(int i) const {
+    return world->IsValidAt(originX + i % gridWidth, originY + i / gridWidth);
+}
+
+
+const int TileGridEnvironment::GetTerrain(int i) const {
+    return world->GetTerrainAt(originX + i % gridWidth, originY + i / gridWidth);
+}
+
+
+void QuadtreeTile::Build(
+    const GridEnvironment& world, int tileX, int tileY, int tileSize, int maxLevel,
+    const std::vector<float>& terrainCosts
+) {
+    this->tileX = tileX;
+    this->tileY = tileY;
+    this->tileSize = tileSize;
+
+    TileGridEnvironment tileGrid;
+    tileGrid.Init(world, (size_t)tileX * tileSize, (size_t)tileY * tileSize, tileSize);
+
+    quadtree.Init(tileSize);
+    quadtree.Build(tileGrid, maxLevel);
+    graph.SetTerrainCosts(terrainCosts);
+    graph.Build(quadtree);
+
+    this->BuildPortals();
+}
+
+
+void QuadtreeTile::Load(int tileX, int tileY, int tileSize, Quadtree&& quadtree, const std::vector<float>& terrainCosts) {
+    this->tileX = tileX;
+    this->tileY = tileY;
+    this->tileSize = tileSize;
+    this->quadtree = std::move(quadtree);
+
+    graph.SetTerrainCosts(terrainCosts);
+    graph.Build(this->quadtree);
+
+    this->BuildPortals();
+}
+
+
+void QuadtreeTile::BuildPortals() {
+    const std::vector<Quadrant>& leafs = quadtree.GetLeafs();
+    const int resolution = quadtree.GetResolution();
+
+    for (int side = 0; side < 4; ++side) {
+        portals[side].clear();
+    }
+
+    for (int i = 0; i < leafs.size(); ++i) {
+        if (!leafs[i].IsValid()) continue;
+
+        const int length = 1 << (resolution - leafs[i].GetLevel());
+        const int x = leafs[i].GetX();
+        const int y = leafs[i].GetY();
+
+        if (y == 0) portals[0].push_back(TilePortal{i, x, length});
+        if (y + length == tileSize) portals[1].push_back(TilePortal{i, x, length});
+        if (x == 0) portals[2].push_back(TilePortal{i, y, length});
+        if (x + length == tileSize) portals[3].push_back(TilePortal{i, y, length});
+    }
+
+    for (int side = 0; side < 4; ++side) {
+        std::sort(portals[side].begin(), portals[side].end(),
+            [](const TilePortal& a, const TilePortal& b) -> bool {
+                return a.offset < b.offset;
+            }
+        );
+    }
+}
+
+
+void QuadtreeTile::FindPortals(int side, int offset, int length, std::vector<TilePortal>& result) const {
+    const std::vector<TilePortal>& sidePortals = portals[side];
+
+    // Portals are disjoint, so their ends are sorted as well
+    auto iterator = std::upper_bound(sidePortals.begin(), sidePortals.end(), offset,
+        [](int value, const TilePortal& portal) -> bool {
+            return value < portal.offset + portal.length;
+        }
+    );
+
+    for (; iterator != sidePortals.end() && iterator->offset < offset + length; ++iterator) {
+        result.push_back(*iterator);
+    }
+}
+
+
+size_t QuadtreeTile::GetMemoryUsage() const {
+    size_t bytes = sizeof(QuadtreeTile);
+
+    bytes += quadtree.GetLeafs().size() * (sizeof(Quadrant) + sizeof(std::vector<int>) + 16);
+    bytes += graph.GetNodes().size() * sizeof(AstarNode);
+    bytes += graph.GetEdges().size() * (sizeof(AstarEdge) + sizeof(int));
+
+    for (int side = 0; side < 4; ++side) {
+        bytes += portals[side].size() * sizeof(TilePortal);
+    }
+
+    return bytes;
+}
+
+
+void QuadtreeForest::Init(size_t worldWidth, size_t worldHeight, int tileSize, int maxLevel) {
+    this->tileSize = tileSize;
+    this->maxLevel = maxLevel;
+    this->tilesX = (worldWidth + tileSize - 1) / tileSize;
+    this->tilesY = (worldHeight + tileSize - 1) / tileSize;
+
+    tiles.clear();
+    tiles.resize((size_t)tilesX * tilesY);
+}
+
+
+void QuadtreeForest::Build(const GridEnvironment& world) {
+    Parallel::For(tilesX * tilesY, [&](int i) {
+        this->BuildTile(world, i % tilesX, i / tilesX);
+    });
+}
+
+
+void QuadtreeForest::BuildTile(const GridEnvironment& world, int tileX, int tileY) {
+    std::shared_ptr<QuadtreeTile> tile = std::make_shared<QuadtreeTile>();
+    tile->Build(world, tileX, tileY, tileSize, maxLevel, terrainCosts);
+
+    std::shared_ptr<const QuadtreeTile>& slot = tiles[(size_t)tileY * tilesX + tileX];
+
+    // Searches still holding the previous tile keep it alive until they let go
+    const std::shared_ptr<const QuadtreeTile> previous = std::atomic_load(&slot);
+    tile->SetVersion(previous != nullptr ? previous->GetVersion() + 1 : 0);
+
+    std::atomic_store(&slot, std::shared_ptr<const QuadtreeTile>(tile));
+}
+
+
+void QuadtreeForest::Rebuild(const GridEnvironment& world, int x, int y, int width, int height) {
+    const int fromTileX = std::max(0, x / tileSize);
+    const int fromTileY = std::max(0, y / tileSize);
+    const int toTileX = std::min(tilesX - 1, (x + width - 1) / tileSize);
+    const int toTileY = std::min(tilesY - 1, (y + height - 1) / tileSize);
+
+    if (toTileX < fromTileX || toTileY < fromTileY) return;
+
+    const int spanX = toTileX - fromTileX + 1;
+
+    Parallel::For(spanX * (toTileY - fromTileY + 1), [&](int i) {
+        this->BuildTile(world, fromTileX + i % spanX, fromTileY + i / spanX);
+    });
+}
+
+
+std::shared_ptr<const QuadtreeTile> QuadtreeForest::GetTile(int tileX, int tileY) {
+    if (tileX < 0 || tileY < 0 || tileX >= tilesX || tileY >= tilesY) {
+        return nullptr;
+    }
+
+    return std::atomic_load(&tiles[(size_t)tileY * tilesX + tileX]);
+}
@@ -0,0 +1,346 @@
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "GridEnvironment.hpp"
+#include "Parallel.hpp"
+#include "Quadtree.hpp"
+#include "QuadtreeForest.hpp"
+#include "QuadtreeStream.hpp"
+#include "TileStore.hpp"
+
+
+namespace {
+    constexpr char MAGIC[4] = {'Q', 'T', 'T', 'S'};
+    constexpr int HEADER_SIZE = 20;
+
+    // Bounds on what Open accepts from a header, tile indices stay within int
+    constexpr uint32_t MAX_TILE_SIZE = 1 << 16;
+    constexpr uint64_t MAX_TILES = 1 << 28;
+
+    void PutU32(std::vector<char>& buffer, uint32_t value) {
+        for (int i = 0; i < 4; ++i) buffer.push_back((char)(value >> (8 * i)));
+    }
+
+    void PutU64(std::vector<char>& buffer, uint64_t value) {
+        for (int i = 0; i < 8; ++i) buffer.push_back((char)(value >> (8 * i)));
+    }
+
+    uint32_t GetU32(const char* data) {
+        uint32_t value = 0;
+        for (int i = 0; i < 4; ++i) value |= (uint32_t)(uint8_t)data[i] << (8 * i);
+        return value;
+    }
+
+    uint64_t GetU64(const char* data) {
+        uint64_t value = 0;
+        for (int i = 0; i < 8; ++i) value |= (uint64_t)(uint8_t)data[i] << (8 * i);
+        return value;
+    }
+
+    bool ReadAt(int file, char* data, size_t size, uint64_t offset) {
+        while (size > 0) {
+            const ssize_t count = pread(file, data, size, offset);
+            if (count <= 0) return false;
+            data += count;
+            size -= count;
+            offset += count;
+        }
+        return true;
+    }
+
+    // Lets QuadtreeStream decode straight from the read buffer
+    class MemoryStreamBuffer : public std::streambuf {
+    public:
+        MemoryStreamBuffer(char* data, size_t size) {
+            this->setg(data, data, data + size);
+        }
+    };
+}
+
+
+namespace TileStore {
+
+    bool Write(const char* path, const GridEnvironment& world, int tileSize, int maxLevel) {
+        std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+        if (!stream) return false;
+
+        const int tilesX = (world.GetWidth() + tileSize - 1) / tileSize;
+        const int tilesY = (world.GetHeight() + tileSize - 1) / tileSize;
+        const int numTiles = tilesX * tilesY;
+
+        std::vector<char> header(MAGIC, MAGIC + 4);
+        PutU32(header, tileSize);
+        PutU32(header, tilesX);
+        PutU32(header, tilesY);
+        PutU32(header, maxLevel);
+
+        // Offset table is filled in once every tile is written
+        const uint64_t tableOffset = header.size();
+        header.resize(header.size() + 8 * (numTiles + 1), 0);
+        stream.write(header.data(), header.size());
+
+        std::vector<uint64_t> offsets;
+        offsets.reserve(numTiles + 1);
+        uint64_t offset = header.size();
+
+        // Build a batch of tiles in parallel, then write it out in order
+        const int batchSize = Parallel::GetNumThreads();
+        std::vector<std::string> encoded(batchSize);
+
+        for (int batchStart = 0; batchStart < numTiles; batchStart += batchSize) {
+            const int count = std::min(batchSize, numTiles - batchStart);
+
+            Parallel::For(count, [&](int i) {
+                const int tileIndex = batchStart + i;
+
+                TileGridEnvironment tileGrid;
+                tileGrid.Init(world, (size_t)(tileIndex % tilesX) * tileSize, (size_t)(tileIndex / tilesX) * tileSize, tileSize);
+
+                Quadtree quadtree;
+                quadtree.Init(tileSize);
+                quadtree.Build(tileGrid, maxLevel);
+
+                std::ostringstream tileStream;
+                QuadtreeStream::Encode(quadtree, tileStream);
+                encoded[i] = tileStream.str();
+            });
+
+            for (int i = 0; i < count; ++i) {
+                offsets.push_back(offset);
+                stream.write(encoded[i].data(), encoded[i].size());
+                offset += encoded[i].size();
+            }
+        }
+
+        offsets.push_back(offset);
+
+        std::vector<char> table;
+        for (uint64_t tileOffset : offsets) {
+            PutU64(table, tileOffset);
+        }
+
+        stream.seekp(tableOffset);
+        stream.write(table.data(), table.size());
+
+        return stream.good();
+    }
+}
+
+
+TileCache::TileCache() {
+    file = -1;
+    memoryBudget = 0;
+    memoryUsage = 0;
+    numHits = 0;
+    numLoads = 0;
+}
+
+
+bool TileCache::Open(const char* path, size_t memoryBudget) {
+    this->Close();
+
+    file = open(path, O_RDONLY);
+    if (file == -1) return false;
+
+    const off_t fileSize = lseek(file, 0, SEEK_END);
+
+    char header[HEADER_SIZE];
+    if (fileSize < HEADER_SIZE || !ReadAt(file, header, HEADER_SIZE, 0) || !std::equal(MAGIC, MAGIC + 4, header)) {
+        this->Close();
+        return false;
+    }
+
+    const uint32_t headerTileSize = GetU32(header + 4);
+    const uint32_t headerTilesX = GetU32(header + 8);
+    const uint32_t headerTilesY = GetU32(header + 12);
+    const uint64_t numTiles = (uint64_t)headerTilesX * headerTilesY;
+    const uint64_t tableSize = 8 * (numTiles + 1);
+
+    // Checked before anything is sized from the header, world coords stay within int
+    if (headerTileSize == 0 || headerTileSize > MAX_TILE_SIZE || numTiles == 0 || numTiles > MAX_TILES
+            || (uint64_t)headerTilesX * headerTileSize > INT_MAX || (uint64_t)headerTilesY * headerTileSize > INT_MAX
+            || HEADER_SIZE + tableSize > (uint64_t)fileSize) {
+        this->Close();
+        return false;
+    }
+
+    std::vector<char> table(tableSize);
+
+    if (!ReadAt(file, table.data(), table.size(), HEADER_SIZE)) {
+        this->Close();
+        return false;
+    }
+
+    offsets.resize(numTiles + 1);
+    for (size_t i = 0; i <= numTiles; ++i) {
+        offsets[i] = GetU64(table.data() + 8 * i);
+    }
+
+    // Tiles lie in order between the table and the end of the file
+    if (offsets[0] < HEADER_SIZE + tableSize || offsets[numTiles] > (uint64_t)fileSize
+            || !std::is_sorted(offsets.begin(), offsets.end())) {
+        this->Close();
+        return false;
+    }
+
+    tileSize = headerTileSize;
+    tilesX = headerTilesX;
+    tilesY = headerTilesY;
+    maxLevel = GetU32(header + 16);
+
+    this->memoryBudget = memoryBudget;
+
+    return true;
+}
+
+
+void TileCache::Close() {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (file != -1) {
+        close(file);
+        file = -1;
+    }
+
+    lru.clear();
+    entries.clear();
+    offsets.clear();
+    memoryUsage = 0;
+}
+
+
+std::shared_ptr<const QuadtreeTile> TileCache::GetTile(int tileX, int tileY) {
+    if (file == -1 || tileX < 0 || tileY < 0 || tileX >= tilesX || tileY >= tilesY) {
+        return nullptr;
+    }
+
+    return this->FetchTile(tileY * tilesX + tileX, true);
+}
+
+
+std::shared_ptr<const QuadtreeTile> TileCache::FetchTile(int tileIndex, bool canEvict) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        auto iterator = entries.find(tileIndex);
+        if (iterator != entries.end()) {
+            numHits++;
+            lru.splice(lru.begin(), lru, iterator->second.lruIterator);
+            return iterator->second.tile;
+        }
+    }
+
+    // Read and decode without the lock so other tiles can be served meanwhile
+    std::shared_ptr<const QuadtreeTile> tile = this->LoadTile(tileIndex);
+    if (tile == nullptr) {
+        return nullptr;
+    }
+
+    const size_t memory = tile->GetMemoryUsage();
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    numLoads++;
+
+    // Another thread loaded the same tile first
+    auto iterator = entries.find(tileIndex);
+    if (iterator != entries.end()) {
+        lru.splice(lru.begin(), lru, iterator->second.lruIterator);
+        return iterator->second.tile;
+    }
+
+    if (!canEvict && memoryUsage + memory > memoryBudget) {
+        return nullptr;
+    }
+
+    lru.push_front(tileIndex);
+    entries.emplace(tileIndex, CacheEntry{tile, lru.begin(), memory});
+    memoryUsage += memory;
+
+    this->Evict(tileIndex);
+
+    return tile;
+}
+
+
+std::shared_ptr<const QuadtreeTile> TileCache::LoadTile(int tileIndex) const {
+    const uint64_t offset = offsets[tileIndex];
+    const uint64_t size = offsets[tileIndex + 1] - offset;
+
+    std::vector<char> readBuffer(size);
+    if (!ReadAt(file, readBuffer.data(), size, offset)) {
+        return nullptr;
+    }
+
+    MemoryStreamBuffer buffer(readBuffer.data(), size);
+    std::istream stream(&buffer);
+
+    Quadtree quadtree;
+    if (!QuadtreeStream::Decode(quadtree, stream)) {
+        return nullptr;
+    }
+
+    // The file does not change while open, so a reloaded tile keeps
+    // version 0 and its node numbers
+    std::shared_ptr<QuadtreeTile> tile = std::make_shared<QuadtreeTile>();
+    tile->Load(tileIndex % tilesX, tileIndex / tilesX, tileSize, std::move(quadtree), terrainCosts);
+
+    return tile;
+}
+
+
+void TileCache::Evict(int keepIndex) {
+    // Tiles still held by a search stay alive until it lets go of them
+    while (memoryUsage > memoryBudget && lru.size() > 0 && lru.back() != keepIndex) {
+        auto iterator = entries.find(lru.back());
+        memoryUsage -= iterator->second.memory;
+        entries.erase(iterator);
+        lru.pop_back();
+    }
+}
+
+
+void TileCache::Prefetch(int fromX, int fromY, int toX, int toY) {
+    if (file == -1) return;
+
+    const float dX = toX - fromX;
+    const float dY = toY - fromY;
+    const int steps = 2 * std::ceil(std::max(std::abs(dX), std::abs(dY)) / tileSize) + 1;
+
+    int lastIndex = -1;
+
+    // Start side first, it is expanded first and the budget may run out before the goal
+    for (int i = 0; i <= steps; ++i) {
+        const int x = fromX + dX * i / steps;
+        const int y = fromY + dY * i / steps;
+        const int tileX = x / tileSize;
+        const int tileY = y / tileSize;
+
+        if (x < 0 || y < 0 || tileX >= tilesX || tileY >= tilesY) continue;
+
+        const int tileIndex = tileY * tilesX + tileX;
+        if (tileIndex == lastIndex) continue;
+        lastIndex = tileIndex;
+
+        // A prefetched tile is only kept when its decoded size fits in what
+        // is left of the budget, so prefetching never pushes out tiles
+        if (this->FetchTile(tileIndex, false) == nullptr) return;
+    }
+}
+
+
+TileCache::~TileCache() {
+    this->Close();
+}
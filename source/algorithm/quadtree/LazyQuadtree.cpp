@@ -0,0 +1,229 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include <ankerl/unordered_dense.h>
+
+#include "BinaryMath.hpp"
+#include "GridEnvironment.hpp"
+#include "LazyQuadtree.hpp"
+#include "Quadtree.hpp"
+
+
+void LazyQuadtree::Init(const GridEnvironment& grid, int maxLevel, size_t memoryBudget) {
+    this->grid = &grid;
+
+    // Smallest power of two square covering the grid, the block keys
+    // leave room for 29 levels
+    const size_t size = std::max(grid.GetWidth(), grid.GetHeight());
+    this->resolution = std::min(29, (int)std::ceil(std::log2(size)));
+    this->maxLevel = std::min(maxLevel, this->resolution);
+
+    this->memoryBudget = memoryBudget;
+    this->clock = 1;
+    this->numCellReads = 0;
+
+    this->blocks.clear();
+}
+
+
+void LazyQuadtree::Clear() {
+    this->blocks.clear();
+}
+
+
+int LazyQuadtree::GetTerrain(uint64_t x, uint64_t y) {
+    if (x >= grid->GetWidth() || y >= grid->GetHeight()) return 0;
+
+    numCellReads++;
+    return grid->GetTerrainAt(x, y);
+}
+
+
+void LazyQuadtree::Store(uint64_t locationCode, int level, int terrain) {
+    blocks.insert_or_assign((locationCode << 5) | level, Block{(uint8_t)terrain, clock});
+}
+
+
+int LazyQuadtree::Classify(uint64_t locationCode, int level) {
+    auto iterator = blocks.find((locationCode << 5) | level);
+
+    if (iterator != blocks.end()) {
+        iterator->second.lastUse = clock;
+        return iterator->second.terrain;
+    }
+
+    const int shift = 2 * (this->resolution - level);
+    const uint64_t size = (uint64_t)1 << shift;
+
+    uint64_t x, y;
+    BinaryMath::Deinterleave(locationCode, x, y);
+
+    const int terrain = this->GetTerrain(x, y);
+
+    uint64_t step;
+
+    for (uint64_t i = 1; i < size; i += step) {
+        BinaryMath::Deinterleave(locationCode + i, x, y);
+
+        step = 1;
+
+        int nextTerrain;
+
+        if (x >= grid->GetWidth() || y >= grid->GetHeight()) {
+            // As in Quadtree::BuildRegion, the largest aligned block
+            // starting here lies entirely outside
+            nextTerrain = 0;
+            step = (uint64_t)1 << (__builtin_ctzll(i) & ~1);
+        } else {
+            nextTerrain = this->GetTerrain(x, y);
+        }
+
+        if (nextTerrain == terrain) continue;
+
+        // The cells before i are uniform, keep them as the largest aligned
+        // blocks so classifying the children does not read them again
+        uint64_t position = 0;
+
+        while (position < i) {
+            int blockShift = position == 0 ? shift - 2 : std::min(shift - 2, __builtin_ctzll(position) & ~1);
+
+            while (position + ((uint64_t)1 << blockShift) > i) {
+                blockShift -= 2;
+            }
+
+            this->Store(locationCode + position, this->resolution - blockShift / 2, terrain);
+            position += (uint64_t)1 << blockShift;
+        }
+
+        this->Store(locationCode, level, MIXED);
+        return MIXED;
+    }
+
+    this->Store(locationCode, level, terrain);
+    return terrain;
+}
+
+
+bool LazyQuadtree::FindLeaf(int x, int y, Quadrant& leaf) {
+    const int side = 1 << this->resolution;
+
+    if (x < 0 || y < 0 || x >= side || y >= side) return false;
+
+    const uint64_t code = BinaryMath::Interleave((uint32_t)x, (uint32_t)y);
+
+    for (int level = 0; level <= this->maxLevel; ++level) {
+        const int shift = 2 * (this->resolution - level);
+        const uint64_t blockCode = code >> shift << shift;
+        const int terrain = this->Classify(blockCode, level);
+
+        if (terrain == MIXED) continue;
+
+        leaf = Quadrant(blockCode, level, terrain);
+        return terrain != 0;
+    }
+
+    // Mixed at maxLevel, left out of the graph as in Quadtree::Build
+    return false;
+}
+
+
+void LazyQuadtree::FindNeighbors(const Quadrant& leaf, std::vector<Quadrant>& neighbors) {
+    const int side = 1 << this->resolution;
+    const int length = 1 << (this->resolution - leaf.GetLevel());
+
+    // SOUTH, NORTH, WEST, EAST as in Quadtree
+    const int offsetX[4] = {0, 0, -length, length};
+    const int offsetY[4] = {-length, length, 0, 0};
+
+    for (int k = 0; k < 4; ++k) {
+        const int x = leaf.GetX() + offsetX[k];
+        const int y = leaf.GetY() + offsetY[k];
+
+        if (x < 0 || y < 0 || x >= side || y >= side) continue;
+
+        const uint64_t code = BinaryMath::Interleave((uint32_t)x, (uint32_t)y);
+
+        // A larger leaf may cover the block of the same size next to this one
+        bool isCovered = false;
+
+        for (int level = 0; level < leaf.GetLevel() && !isCovered; ++level) {
+            const int shift = 2 * (this->resolution - level);
+            const uint64_t blockCode = code >> shift << shift;
+            const int terrain = this->Classify(blockCode, level);
+
+            if (terrain == MIXED) continue;
+
+            if (terrain != 0) {
+                neighbors.emplace_back(blockCode, level, terrain);
+            }
+            isCovered = true;
+        }
+
+        if (!isCovered) {
+            this->CollectSide(code, leaf.GetLevel(), k ^ 1, neighbors);
+        }
+    }
+}
+
+
+void LazyQuadtree::CollectSide(uint64_t locationCode, int level, int side, std::vector<Quadrant>& leafs) {
+    const int terrain = this->Classify(locationCode, level);
+
+    if (terrain != MIXED) {
+        if (terrain != 0) {
+            leafs.emplace_back(locationCode, level, terrain);
+        }
+        return;
+    }
+
+    if (level >= this->maxLevel) return;
+
+    // Child k has x in bit 0 and y in bit 1, SOUTH is the low y side
+    const int children[4][2] = {{0, 1}, {2, 3}, {0, 2}, {1, 3}};
+    const int shift = 2 * (this->resolution - level - 1);
+
+    for (int k = 0; k < 2; ++k) {
+        this->CollectSide(locationCode + ((uint64_t)children[side][k] << shift), level + 1, side, leafs);
+    }
+}
+
+
+void LazyQuadtree::Trim() {
+    clock++;
+
+    if (this->GetMemoryUsage() <= memoryBudget) return;
+
+    const size_t maxBlocks = memoryBudget / BLOCK_MEMORY;
+
+    // A budget below one block keeps nothing
+    if (maxBlocks == 0) {
+        blocks.clear();
+        return;
+    }
+
+    std::vector<uint32_t> lastUses;
+    lastUses.reserve(blocks.size());
+    for (const auto& [key, block] : blocks) {
+        lastUses.emplace_back(block.lastUse);
+    }
+
+    // Keeps the maxBlocks most recently used, ties at the cutoff go first
+    // come first served
+    const size_t numEvicted = blocks.size() - maxBlocks;
+    std::nth_element(lastUses.begin(), lastUses.begin() + numEvicted, lastUses.end());
+    const uint32_t cutoff = lastUses[numEvicted];
+
+    size_t numTies = numEvicted - std::count_if(lastUses.begin(), lastUses.end(), [&](uint32_t lastUse) {
+        return lastUse < cutoff;
+    });
+
+    std::erase_if(blocks, [&](const auto& entry) {
+        if (entry.second.lastUse < cutoff) return true;
+        if (entry.second.lastUse > cutoff || numTies == 0) return false;
+
+        numTies--;
+        return true;
+    });
+}
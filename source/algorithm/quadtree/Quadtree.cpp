@@ -1,8 +1,11 @@
+#include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <cstdint>
 
 #include <cstdio>
 #include <queue>
+#include <utility>
 #include <vector>
 
 #include <ankerl/unordered_dense.h>
@@ -13,11 +16,30 @@
 #include "GridEnvironment.hpp"
 
 
-Quadtree::Quadtree() {}
+namespace {
+    std::atomic<uint64_t> nextVersion(1);
+}
+
+
+Quadtree::Quadtree() {
+    this->version = 0;
+}
 
 void Quadtree::Init(int size) {
-    this->resolution = (int)std::log2(size);
+    this->Init(size, size);
+}
+
+
+void Quadtree::Init(int width, int height) {
+    // Smallest power of two square covering the grid
+    const int size = width > height ? width : height;
+    this->SetResolution((int)std::ceil(std::log2(size)));
+}
+
+
+void Quadtree::SetResolution(int resolution) {
     this->resolution = resolution > 32 ? 32 : resolution;
+    this->maxLevel = this->resolution;
     const int push = (32 - resolution) * 2;
 
     // SOUTH
@@ -78,11 +100,11 @@ int Quadtree::GetChildLevelDiff(const QuadrantIdentifier& parent, int d) const {
 void Quadtree::SubdivideRegionSmall(
     uint64_t fromIndex, 
     uint64_t upperBound, 
-    bool oldValid, 
+    int oldTerrain, 
     int maxLevel
 ) {
     const uint64_t mask = 0xFFFFFFFFFFFFFFE;
-    int shift = __builtin_ctz(fromIndex) & mask; 
+    int shift = __builtin_ctzll(fromIndex) & mask; 
     uint64_t tempIndex = fromIndex >> shift;
 
     uint64_t code; 
@@ -103,7 +125,7 @@ void Quadtree::SubdivideRegionSmall(
             
             if (level <= maxLevel) {
                 leafIndex.emplace(code, this->leafs.size());
-                this->leafs.emplace_back(code, level, oldValid);
+                this->leafs.emplace_back(code, level, oldTerrain);
             }
         
             k++;
@@ -119,11 +141,11 @@ void Quadtree::SubdivideRegionSmall(
 void Quadtree::SubdivideRegionLarge(
     uint64_t fromIndex, 
     const uint64_t lowerBound, 
-    bool oldValid, 
+    int oldTerrain, 
     int maxLevel
 ) {
     const uint64_t mask = 0xFFFFFFFFFFFFFFE;
-    int shift = __builtin_ctz(fromIndex) & mask;
+    int shift = __builtin_ctzll(fromIndex) & mask;
     uint64_t tempIndex = fromIndex >> shift;
 
     uint64_t code; 
@@ -139,7 +161,7 @@ void Quadtree::SubdivideRegionLarge(
             
             if (code < lowerBound) {
                 code = (++tempIndex) << shift;
-                this->SubdivideRegionSmall(lowerBound, code, oldValid, maxLevel);
+                this->SubdivideRegionSmall(lowerBound, code, oldTerrain, maxLevel);
                 return;
             }
 
@@ -147,7 +169,7 @@ void Quadtree::SubdivideRegionLarge(
             // TODO: possible optimization by checking the shift
             if (level <= maxLevel) {
                 leafIndex.emplace(code, this->leafs.size());
-                this->leafs.emplace_back(code, level, oldValid);
+                this->leafs.emplace_back(code, level, oldTerrain);
             }
 
             if (code == lowerBound) return;
@@ -168,35 +190,192 @@ void Quadtree::BuildRegion(
 ) {
     uint64_t x, y;
     
-    bool oldValid = grid.IsValid(0);
+    const uint64_t width = grid.GetWidth();
+    const uint64_t height = grid.GetHeight();
+
+    int oldTerrain = grid.GetTerrain(0);
     uint64_t oldIndex = 0;
 
-    const uint64_t size = grid.GetWidth() * grid.GetHeight();
+    const uint64_t size = this->resolution < 32 ? (uint64_t)1 << (2 * this->resolution) : ~(uint64_t)0;
 
-    bool newValid;
+    int newTerrain;
+    uint64_t step;
 
-    for (uint64_t newIndex = 1; newIndex < size; ++newIndex) {
+    for (uint64_t newIndex = 1; newIndex < size; newIndex += step) {
         BinaryMath::Deinterleave(newIndex, x, y);
-        newValid = grid.IsValid(y * grid.GetWidth() + x);
 
-        if (newValid == oldValid) continue;
+        step = 1;
 
-        this->SubdivideRegionLarge(newIndex, oldIndex, oldValid, maxLevel);
+        if (x >= width || y >= height) {
+            // Padding beyond the grid is blocked, skip the largest aligned
+            // block starting here as it lies entirely outside
+            newTerrain = 0;
+            step = (uint64_t)1 << (__builtin_ctzll(newIndex) & ~1);
+        } else {
+            newTerrain = grid.GetTerrain(y * width + x);
+        }
+
+        if (newTerrain == oldTerrain) continue;
+
+        this->SubdivideRegionLarge(newIndex, oldIndex, oldTerrain, maxLevel);
 
         oldIndex = newIndex;
-        oldValid = newValid;
+        oldTerrain = newTerrain;
     }
 
-    this->SubdivideRegionSmall(oldIndex, size, oldValid, maxLevel);
+    // A grid without any transition becomes a single root leaf below,
+    // a grid whose leafs all lie below maxLevel stays empty
+    if (oldIndex != 0) {
+        this->SubdivideRegionSmall(oldIndex, size, oldTerrain, maxLevel);
+    }
 
-    if (this->leafs.size() == 0) {
+    if (oldIndex == 0) {
         leafIndex.emplace(0, this->leafs.size());
-        this->leafs.emplace_back(0, 0, oldValid);
+        this->leafs.emplace_back(0, 0, oldTerrain);
     }
 }
 
 
 
+void Quadtree::BuildRegionLossy(
+    const GridEnvironment& grid,
+    int maxLevel,
+    float tolerance,
+    bool isConservative
+) {
+    const uint64_t width = grid.GetWidth();
+    const uint64_t height = grid.GetHeight();
+
+    tolerance = std::min(std::max(tolerance, 0.5f), 1.0f);
+
+    // Pyramid in row order per level, covering the grid only. Blocks past
+    // it lie entirely in the padding and are not stored. Blocked cells
+    // count towards blockedCounts only, so minTerrains and maxTerrains
+    // span the valid cells and match when those share a class.
+    std::vector<std::vector<uint64_t>> blockedCounts(this->resolution + 1);
+    std::vector<std::vector<uint8_t>> minTerrains(this->resolution + 1);
+    std::vector<std::vector<uint8_t>> maxTerrains(this->resolution + 1);
+    std::vector<uint64_t> levelWidths(this->resolution + 1);
+    std::vector<uint64_t> levelHeights(this->resolution + 1);
+
+    for (int level = this->resolution; level >= 0; --level) {
+        const int shift = this->resolution - level;
+
+        levelWidths[level] = (width + ((uint64_t)1 << shift) - 1) >> shift;
+        levelHeights[level] = (height + ((uint64_t)1 << shift) - 1) >> shift;
+
+        const uint64_t numBlocks = levelWidths[level] * levelHeights[level];
+
+        blockedCounts[level].resize(numBlocks);
+        minTerrains[level].resize(numBlocks);
+        maxTerrains[level].resize(numBlocks);
+    }
+
+    for (uint64_t y = 0; y < height; ++y) {
+        for (uint64_t x = 0; x < width; ++x) {
+            const uint64_t index = y * width + x;
+            const int terrain = grid.GetTerrain(index);
+
+            blockedCounts[this->resolution][index] = terrain == 0;
+            minTerrains[this->resolution][index] = terrain == 0 ? UINT8_MAX : terrain;
+            maxTerrains[this->resolution][index] = terrain;
+        }
+    }
+
+    // Statistics of any block, padding blocks are fully blocked
+    auto getBlock = [&](int level, uint64_t x, uint64_t y, uint64_t& blocked, uint8_t& minTerrain, uint8_t& maxTerrain) {
+        if (x >= levelWidths[level] || y >= levelHeights[level]) {
+            blocked = (uint64_t)1 << (2 * (this->resolution - level));
+            minTerrain = UINT8_MAX;
+            maxTerrain = 0;
+            return;
+        }
+
+        const uint64_t index = y * levelWidths[level] + x;
+        blocked = blockedCounts[level][index];
+        minTerrain = minTerrains[level][index];
+        maxTerrain = maxTerrains[level][index];
+    };
+
+    for (int level = this->resolution - 1; level >= 0; --level) {
+        for (uint64_t y = 0; y < levelHeights[level]; ++y) {
+            for (uint64_t x = 0; x < levelWidths[level]; ++x) {
+                uint64_t blocked = 0;
+                uint8_t minTerrain = UINT8_MAX;
+                uint8_t maxTerrain = 0;
+
+                for (int k = 0; k < 4; ++k) {
+                    uint64_t childBlocked;
+                    uint8_t childMin, childMax;
+                    getBlock(level + 1, 2 * x + (k & 1), 2 * y + (k >> 1), childBlocked, childMin, childMax);
+
+                    blocked += childBlocked;
+                    minTerrain = std::min(minTerrain, childMin);
+                    maxTerrain = std::max(maxTerrain, childMax);
+                }
+
+                const uint64_t index = y * levelWidths[level] + x;
+                blockedCounts[level][index] = blocked;
+                minTerrains[level][index] = minTerrain;
+                maxTerrains[level][index] = maxTerrain;
+            }
+        }
+    }
+
+    // Depth first from the root so the leafs come out in Morton order
+    struct PendingBlock {
+        uint64_t x;
+        uint64_t y;
+        int level;
+    };
+
+    std::vector<PendingBlock> blocks;
+    blocks.push_back(PendingBlock{0, 0, 0});
+
+    while (blocks.size() > 0) {
+        const PendingBlock block = blocks.back();
+        blocks.pop_back();
+
+        const int level = block.level;
+        const double numCells = (double)((uint64_t)1 << (2 * (this->resolution - level)));
+
+        uint64_t blocked;
+        uint8_t minTerrain, maxTerrain;
+        getBlock(level, block.x, block.y, blocked, minTerrain, maxTerrain);
+
+        const double valid = numCells - blocked;
+
+        int terrain = -1;
+
+        if (blocked >= tolerance * numCells) {
+            terrain = 0;
+        } else if (valid >= tolerance * numCells && minTerrain == maxTerrain && (blocked == 0 || !isConservative)) {
+            terrain = minTerrain;
+        } else if (level >= maxLevel) {
+            // Exact as Build, whose leafs below maxLevel are left out
+            if (tolerance >= 1.0f) continue;
+
+            if (isConservative ? blocked > 0 : blocked > valid) {
+                terrain = 0;
+            } else {
+                // Mixed classes keep the highest one present
+                terrain = maxTerrain;
+            }
+        }
+
+        if (terrain != -1) {
+            const int shift = this->resolution - level;
+            this->AddLeaf(BinaryMath::Interleave((uint32_t)(block.x << shift), (uint32_t)(block.y << shift)), level, terrain);
+            continue;
+        }
+
+        for (int k = 3; k >= 0; --k) {
+            blocks.push_back(PendingBlock{2 * block.x + (k & 1), 2 * block.y + (k >> 1), level + 1});
+        }
+    }
+}
+
+
 /**
  * Implementation of Linear Quadtree with Level Differences from
  * A Constant-Time Algorithm for Finding Neighbors in Quadtrees
@@ -314,11 +493,35 @@ void Quadtree::BuildGraph(
 }
 
 void Quadtree::Build(const GridEnvironment& grid, int maxLevel) {
+    this->Clear();
+    this->BuildRegion(grid, maxLevel);
+    this->Finalize(maxLevel);
+}
+
+
+void Quadtree::BuildLossy(const GridEnvironment& grid, int maxLevel, float tolerance, bool isConservative) {
+    this->Clear();
+    this->BuildRegionLossy(grid, maxLevel, tolerance, isConservative);
+    this->Finalize(maxLevel);
+}
+
+
+void Quadtree::Clear() {
     this->quadtreeGraph.clear();
     this->leafs.clear();
     this->leafIndex.clear();
+}
+
+
+void Quadtree::AddLeaf(uint64_t locationCode, int level, int terrain) {
+    leafIndex.emplace(locationCode, this->leafs.size());
+    this->leafs.emplace_back(locationCode, level, terrain);
+}
 
-    this->BuildRegion(grid, maxLevel);
+
+void Quadtree::Finalize(int maxLevel) {
+    this->maxLevel = maxLevel;
+    this->version = nextVersion++;
 
     if (this->leafs.size() > 0) {
         ankerl::unordered_dense::map<uint64_t, QuadrantIdentifier> mapIdentifiers;
@@ -326,10 +529,20 @@ void Quadtree::Build(const GridEnvironment& grid, int maxLevel) {
         this->BuildLevelDifferences(mapIdentifiers, maxLevel);
         this->BuildGraph(mapIdentifiers, maxLevel);
     }
-
 }
 
 int Quadtree::QueryValidRegion(uint32_t x, uint32_t y) const {
+    const int index = this->QueryRegion(x, y);
+
+    if (index == -1 || !this->leafs[index].IsValid()) {
+        return -1;
+    }
+
+    return index;
+}
+
+
+int Quadtree::QueryRegion(uint32_t x, uint32_t y) const {
     int result = -1;
 
     uint64_t z = BinaryMath::Interleave(x, y);
@@ -345,9 +558,8 @@ int Quadtree::QueryValidRegion(uint32_t x, uint32_t y) const {
             const int length = (1 << (resolution - level));
             const int leafX = this->leafs[index].GetX();
             const int leafY = this->leafs[index].GetY();
-            const bool isValid = this->leafs[index].IsValid();
 
-            if (isValid && (x > leafX) && (y > leafY) && (x < leafX + length) && (y < leafY + length)) {
+            if ((x >= leafX) && (y >= leafY) && (x < leafX + length) && (y < leafY + length)) {
                 result = iterator->second;
             }
 
@@ -358,7 +570,27 @@ int Quadtree::QueryValidRegion(uint32_t x, uint32_t y) const {
         mask <<= 2;
     }
 
-
-    fflush(stdout);
     return result;
+}
+
+
+int Quadtree::FindLeaf(uint64_t locationCode, int level) const {
+    const auto iterator = leafIndex.find(locationCode);
+
+    if (iterator == leafIndex.end() || this->leafs[iterator->second].GetLevel() != level) {
+        return -1;
+    }
+
+    return iterator->second;
+}
+
+
+int Quadtree::FindLeaf(const LeafKey& key) const {
+    const int leaf = this->FindLeaf(key.locationCode, key.level);
+
+    if (leaf == -1 || this->leafs[leaf].GetTerrain() != key.terrain) {
+        return -1;
+    }
+
+    return leaf;
 }
\ No newline at end of file
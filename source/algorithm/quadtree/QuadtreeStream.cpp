@@ -0,0 +1,247 @@
+#include <algorithm>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+#include "GridEnvironment.hpp"
+#include "Quadtree.hpp"
+#include "QuadtreeStream.hpp"
+
+
+namespace QuadtreeStream {
+
+    // The last magic byte is the format version, version 1 streams stored
+    // a valid flag where version 2 stores the terrain class
+    static constexpr uint8_t MAGIC[4] = {'Q', 'T', 'Z', 2};
+    static constexpr int BITS_PER_LEAF = 10; // 6 bits level, 4 bits terrain
+    static constexpr int BITS_PER_LEAF_V1 = 7; // 6 bits level, 1 bit valid
+
+
+    static void WriteVarint(std::vector<uint8_t>& buffer, uint64_t value) {
+        while (value >= 0x80) {
+            buffer.push_back((uint8_t)(value | 0x80));
+            value >>= 7;
+        }
+        buffer.push_back((uint8_t)value);
+    }
+
+
+    static bool ReadVarint(const uint8_t*& it, const uint8_t* end, uint64_t& value) {
+        value = 0;
+        for (int shift = 0; shift < 64 && it != end; shift += 7) {
+            const uint8_t byte = *(it++);
+            value |= (uint64_t)(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) return true;
+        }
+        return false;
+    }
+
+
+    static bool ReadVarint(std::istream& stream, uint64_t& value) {
+        value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            const int byte = stream.get();
+            if (byte == std::istream::traits_type::eof()) return false;
+            value |= (uint64_t)(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) return true;
+        }
+        return false;
+    }
+
+
+    // Appends numBits of bits at bitOffset, packed must already hold them
+    static void WriteBits(std::vector<uint8_t>& packed, uint64_t bitOffset, uint32_t bits, int numBits) {
+        for (int i = 0; i < numBits; i += 8 - (bitOffset + i) % 8) {
+            packed[(bitOffset + i) / 8] |= (uint8_t)((bits >> i) << ((bitOffset + i) % 8));
+        }
+    }
+
+
+    static uint32_t ReadBits(const uint8_t* packed, uint64_t bitOffset, int numBits) {
+        uint32_t bits = 0;
+        for (int i = 0; i < numBits; i += 8 - (bitOffset + i) % 8) {
+            bits |= (uint32_t)(packed[(bitOffset + i) / 8] >> ((bitOffset + i) % 8)) << i;
+        }
+        return bits & ((1u << numBits) - 1);
+    }
+
+
+    // Code directly after the last cell covered by a leaf
+    static uint64_t GetEndCode(uint64_t code, int level, int resolution) {
+        const int shift = 2 * (resolution - level);
+        return shift >= 64 ? 0 : code + ((uint64_t)1 << shift);
+    }
+
+
+    static void WriteChunk(
+        std::ostream& stream,
+        const std::vector<uint8_t>& payload,
+        const std::vector<uint8_t>& packed,
+        int count
+    ) {
+        std::vector<uint8_t> header;
+        WriteVarint(header, count);
+        WriteVarint(header, payload.size() + packed.size());
+
+        stream.write((const char*)header.data(), header.size());
+        stream.write((const char*)payload.data(), payload.size());
+        stream.write((const char*)packed.data(), packed.size());
+    }
+
+
+    bool Encode(const Quadtree& quadtree, std::ostream& stream) {
+        const std::vector<Quadrant>& leafs = quadtree.GetLeafs();
+        const int resolution = quadtree.GetResolution();
+        const int maxLevel = std::min(quadtree.GetMaxLevel(), resolution);
+
+        std::vector<uint8_t> header(MAGIC, MAGIC + 4);
+        header.push_back((uint8_t)resolution);
+        header.push_back((uint8_t)maxLevel);
+        WriteVarint(header, leafs.size());
+        stream.write((const char*)header.data(), header.size());
+
+        std::vector<uint8_t> payload;
+        std::vector<uint8_t> packed;
+        int count = 0;
+        uint64_t nextCode = 0;
+
+        // Depth first walk yields the leafs in Morton order without sorting a copy
+        std::vector<std::pair<uint64_t, int>> stack;
+        stack.emplace_back(0, 0);
+
+        while (stack.size() > 0) {
+            const auto [code, level] = stack.back();
+            stack.pop_back();
+
+            const int index = quadtree.FindLeaf(code, level);
+
+            if (index == -1) {
+                if (level >= maxLevel || level >= resolution) continue;
+
+                const int childShift = 2 * (resolution - level - 1);
+                for (int k = 3; k >= 0; --k) {
+                    stack.emplace_back(code | ((uint64_t)k << childShift), level + 1);
+                }
+                continue;
+            }
+
+            WriteVarint(payload, code - nextCode);
+            nextCode = GetEndCode(code, level, resolution);
+
+            const uint32_t bits = level | (std::min(leafs[index].GetTerrain(), MAX_TERRAIN) << 6);
+            const int bitOffset = count * BITS_PER_LEAF;
+            packed.resize((bitOffset + BITS_PER_LEAF + 7) / 8, 0);
+            WriteBits(packed, bitOffset, bits, BITS_PER_LEAF);
+
+            if (++count == CHUNK_SIZE) {
+                WriteChunk(stream, payload, packed, count);
+                payload.clear();
+                packed.clear();
+                count = 0;
+            }
+        }
+
+        if (count > 0) {
+            WriteChunk(stream, payload, packed, count);
+        }
+
+        // Terminating empty chunk
+        stream.put(0);
+
+        return stream.good();
+    }
+
+
+    bool Decode(Quadtree& quadtree, std::istream& stream) {
+        uint8_t header[6];
+        if (!stream.read((char*)header, 6)) return false;
+
+        for (int i = 0; i < 3; ++i) {
+            if (header[i] != MAGIC[i]) return false;
+        }
+
+        if (header[3] != 1 && header[3] != MAGIC[3]) return false;
+
+        const int bitsPerLeaf = header[3] == 1 ? BITS_PER_LEAF_V1 : BITS_PER_LEAF;
+
+        const int resolution = header[4];
+        const int maxLevel = header[5];
+
+        if (resolution > 32 || maxLevel > resolution) return false;
+
+        uint64_t leafCount;
+        if (!ReadVarint(stream, leafCount)) return false;
+
+        // Decoded aside so a failure leaves the caller's tree untouched
+        Quadtree decodedTree;
+        decodedTree.SetResolution(resolution);
+        decodedTree.Clear();
+
+        std::vector<uint8_t> chunk;
+        std::vector<uint64_t> codes;
+        uint64_t nextCode = 0;
+        uint64_t decoded = 0;
+
+        // Set once a leaf ends at the top of the code range, which only
+        // happens at resolution 32 where the end code wraps to 0
+        bool isExhausted = false;
+
+        while (true) {
+            uint64_t count, size;
+            if (!ReadVarint(stream, count)) return false;
+            if (count == 0) break;
+            if (count > CHUNK_SIZE || count > leafCount - decoded) return false;
+
+            // A gap varint takes at most 10 bytes
+            if (!ReadVarint(stream, size) || size > count * 12 + 1) return false;
+
+            chunk.resize(size);
+            if (!stream.read((char*)chunk.data(), size)) return false;
+
+            const uint8_t* it = chunk.data();
+            const uint8_t* end = chunk.data() + size;
+
+            codes.resize(count);
+            for (uint64_t i = 0; i < count; ++i) {
+                if (!ReadVarint(it, end, codes[i])) return false;
+            }
+
+            if ((uint64_t)(end - it) * 8 < count * bitsPerLeaf) return false;
+
+            for (uint64_t i = 0; i < count; ++i) {
+                const uint32_t bits = ReadBits(it, i * bitsPerLeaf, bitsPerLeaf);
+
+                const int level = bits & 0x3F;
+                const int terrain = bits >> 6;
+
+                // maxLevel is at most the resolution, so this also bounds the level
+                if (level > maxLevel) return false;
+
+                const uint64_t code = nextCode + codes[i];
+
+                // Reject gaps that wrap around or land outside the tree, and
+                // codes not aligned to the size of their block
+                const int shift = 2 * (resolution - level);
+                if (isExhausted || code < nextCode) return false;
+                if (resolution < 32 && code >> (2 * resolution) != 0) return false;
+                if (shift < 64 && (code & (((uint64_t)1 << shift) - 1)) != 0) return false;
+
+                nextCode = GetEndCode(code, level, resolution);
+                isExhausted = nextCode <= code;
+
+                decodedTree.AddLeaf(code, level, terrain);
+            }
+
+            decoded += count;
+        }
+
+        if (decoded != leafCount) return false;
+
+        decodedTree.Finalize(maxLevel);
+        quadtree = std::move(decodedTree);
+
+        return true;
+    }
+}
@@ -2,4 +2,11 @@
 
 const bool ImageGridEnvironment::IsValid(int i) const {
     return pixels[i].r != 0; 
-}
\ No newline at end of file
+}
+
+
+const int ImageGridEnvironment::GetTerrain(int i) const {
+    if (pixels[i].r == 0) return 0;
+
+    return 1 + pixels[i].r * numTerrains / 256;
+}